@@ -1,6 +1,7 @@
 #include <chrono>
 
 #include "include/FTArray.h"
+#include "include/Queue.h"
 
 double mticks()
 {
@@ -45,8 +46,158 @@ void Benchmark(const int nTestNum)
 	g_dbResults[nTestNum] = VectorDuration.count() + ArrayDuration.count();
 }
 
+#define QUEUE_TEST_AMOUNT 10000000
+#define QUEUE_LATENCY_ROUND_TRIPS 100000
+
+// Producer and consumer run on their own threads, items have to arrive in order and complete
+bool TestSpscQueue()
+{
+	typedef std::chrono::high_resolution_clock clock;
+	typedef std::chrono::duration<float, std::milli> duration;
+
+	FTSpscQueue<int> Queue(1024, FTQueueWait::Yield);
+
+	const clock::time_point Start = clock::now();
+
+	std::thread Producer([&Queue]()
+		{
+			int Batch[64];
+			for (int i = 0; i < QUEUE_TEST_AMOUNT; i += 64)
+			{
+				const int nNum = (QUEUE_TEST_AMOUNT - i < 64) ? QUEUE_TEST_AMOUNT - i : 64;
+				for (int j = 0; j < nNum; j++)
+					Batch[j] = i + j;
+
+				Queue.PushAll(Batch, nNum);
+			}
+		});
+
+	int nExpected = 0;
+	int nErrors = 0;
+	int Batch[64];
+	while (nExpected < QUEUE_TEST_AMOUNT)
+	{
+		const int nNum = Queue.PopN(Batch, 64);
+		for (int i = 0; i < nNum; i++)
+		{
+			if (Batch[i] != nExpected++)
+				nErrors++;
+		}
+
+		if (!nNum)
+			std::this_thread::yield();
+	}
+
+	Producer.join();
+
+	const duration Duration = clock::now() - Start;
+	printf("FTSpscQueue: %i items, %i out of order, %f million items/s\n", QUEUE_TEST_AMOUNT, nErrors,
+		QUEUE_TEST_AMOUNT / Duration.count() / 1000.0f);
+
+	// Ping-pong over two queues, half a round trip is the stage to stage latency
+	FTSpscQueue<int> Ping(16, FTQueueWait::Yield);
+	FTSpscQueue<int> Pong(16, FTQueueWait::Yield);
+
+	std::thread Echo([&Ping, &Pong]()
+		{
+			int nValue;
+			for (int i = 0; i < QUEUE_LATENCY_ROUND_TRIPS; i++)
+			{
+				Ping.Pop(nValue);
+				Pong.Push(nValue);
+			}
+		});
+
+	const clock::time_point LatencyStart = clock::now();
+	for (int i = 0; i < QUEUE_LATENCY_ROUND_TRIPS; i++)
+	{
+		int nValue;
+		Ping.Push(i);
+		Pong.Pop(nValue);
+
+		if (nValue != i)
+			nErrors++;
+	}
+	const duration LatencyDuration = clock::now() - LatencyStart;
+
+	Echo.join();
+
+	printf("FTSpscQueue: %f ns per hop\n", LatencyDuration.count() * 1000000.0f / (QUEUE_LATENCY_ROUND_TRIPS * 2));
+
+	return nErrors == 0;
+}
+
+// Several producers and consumers, every pushed value has to be popped exactly once
+bool TestMpmcQueue()
+{
+	typedef std::chrono::high_resolution_clock clock;
+	typedef std::chrono::duration<float, std::milli> duration;
+
+	constexpr int nNumProducers = 2;
+	constexpr int nNumConsumers = 2;
+	constexpr int nPerProducer = QUEUE_TEST_AMOUNT / nNumProducers;
+
+	FTMpmcQueue<long long> Queue(1024, FTQueueWait::Yield);
+	std::atomic<long long> Total{ 0 };
+	std::atomic<int> Popped{ 0 };
+
+	const clock::time_point Start = clock::now();
+
+	std::vector<std::thread> Threads;
+	for (int t = 0; t < nNumProducers; t++)
+	{
+		Threads.emplace_back([&Queue, t]()
+			{
+				for (int i = 0; i < nPerProducer; i++)
+					Queue.Push(static_cast<long long>(i) * nNumProducers + t);
+			});
+	}
+
+	for (int t = 0; t < nNumConsumers; t++)
+	{
+		Threads.emplace_back([&Queue, &Total, &Popped]()
+			{
+				long long nSum = 0;
+				long long nValue;
+				while (Popped.load(std::memory_order_relaxed) < nPerProducer * nNumProducers)
+				{
+					if (!Queue.TryPop(nValue))
+					{
+						std::this_thread::yield();
+						continue;
+					}
+
+					nSum += nValue;
+					Popped.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				Total += nSum;
+			});
+	}
+
+	for (std::thread& Thread : Threads)
+		Thread.join();
+
+	const duration Duration = clock::now() - Start;
+
+	// Every value in [0, nPerProducer * nNumProducers) was pushed once
+	const long long nCount = static_cast<long long>(nPerProducer) * nNumProducers;
+	const long long nExpected = nCount * (nCount - 1) / 2;
+
+	printf("FTMpmcQueue: %i producers, %i consumers, sum %s, %f million items/s\n", nNumProducers, nNumConsumers,
+		(Total == nExpected) ? "ok" : "WRONG", nCount / Duration.count() / 1000.0f);
+
+	return Total == nExpected;
+}
+
 int main()
 {
+	if (!TestSpscQueue() || !TestMpmcQueue())
+	{
+		printf("Queue tests failed\n");
+		return 1;
+	}
+
 	for (int i = 0; i < TEST_AMOUNT; i++)
 	{
 		Benchmark(i);
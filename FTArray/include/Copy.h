@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "Globals.h"
+
+// Default size from which copies bypass the cache, about the size of a desktop L3
+constexpr size_t FT_NON_TEMPORAL_COPY_THRESHOLD = static_cast<size_t>(32) << 20;
+
+// How far ahead of the streaming loop the source is prefetched
+constexpr int FT_COPY_PREFETCH_DISTANCE = 512;
+
+/*
+ * Bulk copy for trivially copyable data
+ * Below the threshold this is memcpy. Above it the destination is written with streaming stores
+ * and the source prefetched as non-temporal, so copying a few hundred MB doesn't evict
+ * everything else from the cache on the way through
+ */
+class FTCopy
+{
+public:
+	// Meant to be set once at startup, e.g. to the L3 size of the machine
+	static __forceinline void SetNonTemporalThreshold(const size_t nBytes) noexcept
+	{
+		s_nNonTemporalThreshold = nBytes;
+	}
+
+	static __forceinline size_t GetNonTemporalThreshold() noexcept
+	{
+		return s_nNonTemporalThreshold;
+	}
+
+	// pDest and pSrc must not overlap
+	static __forceinline void Copy(void* pDest, const void* pSrc, const size_t nBytes) noexcept
+	{
+		if (nBytes < s_nNonTemporalThreshold)
+			memcpy(pDest, pSrc, nBytes);
+		else
+			CopyNonTemporal(pDest, pSrc, nBytes);
+	}
+
+	static void CopyNonTemporal(void* pDest, const void* pSrc, size_t nBytes) noexcept
+	{
+		char* pDestBytes = static_cast<char*>(pDest);
+		const char* pSrcBytes = static_cast<const char*>(pSrc);
+
+		// Streaming stores need an aligned destination, the unaligned head goes through memcpy
+		size_t nHead = (16 - (reinterpret_cast<uintptr_t>(pDestBytes) & 15)) & 15;
+		if (nHead > nBytes)
+			nHead = nBytes;
+
+		memcpy(pDestBytes, pSrcBytes, nHead);
+		pDestBytes += nHead;
+		pSrcBytes += nHead;
+		nBytes -= nHead;
+
+		for (; nBytes >= 64; nBytes -= 64, pDestBytes += 64, pSrcBytes += 64)
+		{
+			_mm_prefetch(pSrcBytes + FT_COPY_PREFETCH_DISTANCE, _MM_HINT_NTA);
+
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrcBytes));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrcBytes + 16));
+			const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrcBytes + 32));
+			const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrcBytes + 48));
+
+			_mm_stream_si128(reinterpret_cast<__m128i*>(pDestBytes), a);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(pDestBytes + 16), b);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(pDestBytes + 32), c);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(pDestBytes + 48), d);
+		}
+
+		// Streaming stores are weakly ordered, make them visible before anyone reads the copy
+		_mm_sfence();
+
+		memcpy(pDestBytes, pSrcBytes, nBytes);
+	}
+
+private:
+	static inline size_t s_nNonTemporalThreshold = FT_NON_TEMPORAL_COPY_THRESHOLD;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+
+#include "Globals.h"
+
+// MSVC lets any function use AVX2 intrinsics, other compilers need the function marked for it
+#if defined(_MSC_VER)
+#define FT_TARGET_AVX2
+#else
+#define FT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+class FTCpu
+{
+public:
+	// Checked once, the result is cached for every later dispatch
+	static __forceinline bool HasAvx2() noexcept
+	{
+		static const bool s_bHasAvx2 = DetectAvx2();
+		return s_bHasAvx2;
+	}
+
+private:
+	static bool DetectAvx2() noexcept
+	{
+#if defined(_MSC_VER)
+		int Info[4];
+
+		__cpuid(Info, 0);
+		if (Info[0] < 7)
+			return false;
+
+		// The CPU has to support AVX and the OS has to save the YMM registers (OSXSAVE + XCR0)
+		__cpuid(Info, 1);
+		if (!(Info[2] & (1 << 27)) || !(Info[2] & (1 << 28)))
+			return false;
+
+		if ((_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(Info, 7, 0);
+		return (Info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+};
@@ -0,0 +1,330 @@
+#pragma once
+#include <cmath>
+#include <type_traits>
+
+#include "Reduce.h"
+#include "Globals.h"
+
+template<typename T>
+class FTArray;
+
+/*
+ * Lazy element-wise arithmetic for numeric FTArrays
+ * Operators don't compute anything, they build a tree of small nodes (pointer + size for arrays,
+ * the value for scalars) which is evaluated in one fused loop when it is assigned to an FTArray
+ * or passed to a reduction, so `a = b * c + d` makes a single pass over memory and no temporaries
+ */
+template<typename E>
+class FTExpression
+{
+public:
+	__forceinline const E& Self() const noexcept
+	{
+		return static_cast<const E&>(*this);
+	}
+
+	__forceinline int GetSize() const noexcept
+	{
+		return Self().GetSize();
+	}
+};
+
+template<typename T>
+class FTArrayTerminal : public FTExpression<FTArrayTerminal<T>>
+{
+public:
+	using ValueType = T;
+
+	__forceinline FTArrayTerminal(const T* pData, const int nSize) noexcept
+		: m_pData(pData), m_nSize(nSize)
+	{
+	}
+
+	__forceinline int GetSize() const noexcept
+	{
+		return m_nSize;
+	}
+
+	__forceinline T operator[](const int nIndex) const noexcept
+	{
+		return m_pData[nIndex];
+	}
+
+	__forceinline const T* GetData() const noexcept
+	{
+		return m_pData;
+	}
+
+private:
+	const T* m_pData;
+	int m_nSize;
+};
+
+template<typename T>
+class FTScalarTerminal : public FTExpression<FTScalarTerminal<T>>
+{
+public:
+	using ValueType = T;
+
+	__forceinline explicit FTScalarTerminal(const T Value) noexcept : m_Value(Value) {}
+
+	// Scalars have no size of their own, they broadcast to the size of the other operand
+	__forceinline int GetSize() const noexcept
+	{
+		return FT_INVALID_INDEX;
+	}
+
+	__forceinline T operator[](const int) const noexcept
+	{
+		return m_Value;
+	}
+
+private:
+	T m_Value;
+};
+
+template<typename L, typename R, typename Op>
+class FTBinaryExpression : public FTExpression<FTBinaryExpression<L, R, Op>>
+{
+public:
+	using ValueType = std::common_type_t<typename L::ValueType, typename R::ValueType>;
+
+	__forceinline FTBinaryExpression(const L& Lhs, const R& Rhs) noexcept : m_Lhs(Lhs), m_Rhs(Rhs)
+	{
+		FT_ASSERT(Lhs.GetSize() == FT_INVALID_INDEX || Rhs.GetSize() == FT_INVALID_INDEX
+			|| Lhs.GetSize() == Rhs.GetSize());
+	}
+
+	__forceinline int GetSize() const noexcept
+	{
+		return (m_Lhs.GetSize() != FT_INVALID_INDEX) ? m_Lhs.GetSize() : m_Rhs.GetSize();
+	}
+
+	__forceinline ValueType operator[](const int nIndex) const noexcept
+	{
+		return Op::Apply(static_cast<ValueType>(m_Lhs[nIndex]), static_cast<ValueType>(m_Rhs[nIndex]));
+	}
+
+private:
+	// Children are held by value, nodes are tiny and this keeps sub-expressions alive
+	L m_Lhs;
+	R m_Rhs;
+};
+
+template<typename E, typename Op>
+class FTUnaryExpression : public FTExpression<FTUnaryExpression<E, Op>>
+{
+public:
+	using ValueType = typename E::ValueType;
+
+	__forceinline explicit FTUnaryExpression(const E& Operand) noexcept : m_Operand(Operand) {}
+
+	__forceinline int GetSize() const noexcept
+	{
+		return m_Operand.GetSize();
+	}
+
+	__forceinline ValueType operator[](const int nIndex) const noexcept
+	{
+		return Op::Apply(m_Operand[nIndex]);
+	}
+
+private:
+	E m_Operand;
+};
+
+struct FTOpAdd
+{
+	template<typename T>
+	static __forceinline T Apply(const T a, const T b) noexcept { return static_cast<T>(a + b); }
+};
+
+struct FTOpSubtract
+{
+	template<typename T>
+	static __forceinline T Apply(const T a, const T b) noexcept { return static_cast<T>(a - b); }
+};
+
+struct FTOpMultiply
+{
+	template<typename T>
+	static __forceinline T Apply(const T a, const T b) noexcept { return static_cast<T>(a * b); }
+};
+
+struct FTOpDivide
+{
+	template<typename T>
+	static __forceinline T Apply(const T a, const T b) noexcept { return static_cast<T>(a / b); }
+};
+
+struct FTOpNegate
+{
+	template<typename T>
+	static __forceinline T Apply(const T a) noexcept { return static_cast<T>(-a); }
+};
+
+// Maps anything that can take part in an expression (nodes and numeric FTArrays) to its node type
+template<typename T, typename = void>
+struct FTExpressionTraits
+{
+	static constexpr bool bIsExpression = false;
+};
+
+template<typename E>
+struct FTExpressionTraits<E, std::enable_if_t<std::is_base_of<FTExpression<E>, E>::value>>
+{
+	static constexpr bool bIsExpression = true;
+	using Type = E;
+
+	static __forceinline const E& Make(const E& Expr) noexcept
+	{
+		return Expr;
+	}
+};
+
+template<typename T>
+struct FTExpressionTraits<FTArray<T>, std::enable_if_t<std::is_arithmetic<T>::value>>
+{
+	static constexpr bool bIsExpression = true;
+	using Type = FTArrayTerminal<T>;
+
+	static __forceinline Type Make(const FTArray<T>& Array) noexcept
+	{
+		return Type(Array.GetBase(), Array.GetSize());
+	}
+};
+
+template<typename T>
+using FTExpressionType = typename FTExpressionTraits<std::decay_t<T>>::Type;
+
+/*
+ * Scalars keep the value type of a floating point operand so `FloatArray * 2.0` stays in float,
+ * otherwise the usual promotion applies so `IntArray * 0.5` is computed in double
+ */
+template<typename V, typename S>
+using FTScalarType = std::conditional_t<std::is_floating_point<V>::value, V, std::common_type_t<V, S>>;
+
+template<typename Op, typename L, typename R>
+__forceinline FTBinaryExpression<FTExpressionType<L>, FTExpressionType<R>, Op>
+FTMakeBinaryExpression(const L& Lhs, const R& Rhs) noexcept
+{
+	return FTBinaryExpression<FTExpressionType<L>, FTExpressionType<R>, Op>(
+		FTExpressionTraits<L>::Make(Lhs), FTExpressionTraits<R>::Make(Rhs));
+}
+
+#define FT_DEFINE_EXPRESSION_OPERATOR(Operator, Op)                                                              \
+	template<typename L, typename R, std::enable_if_t<FTExpressionTraits<L>::bIsExpression                      \
+		&& FTExpressionTraits<R>::bIsExpression, int> = 0>                                                       \
+	__forceinline auto Operator(const L& Lhs, const R& Rhs) noexcept                                             \
+	{                                                                                                            \
+		return FTMakeBinaryExpression<Op>(Lhs, Rhs);                                                             \
+	}                                                                                                            \
+                                                                                                                 \
+	template<typename L, typename S, std::enable_if_t<FTExpressionTraits<L>::bIsExpression                      \
+		&& std::is_arithmetic<S>::value, int> = 0>                                                               \
+	__forceinline auto Operator(const L& Lhs, const S Rhs) noexcept                                              \
+	{                                                                                                            \
+		using V = FTScalarType<typename FTExpressionType<L>::ValueType, S>;                                     \
+		return FTMakeBinaryExpression<Op>(Lhs, FTScalarTerminal<V>(static_cast<V>(Rhs)));                        \
+	}                                                                                                            \
+                                                                                                                 \
+	template<typename S, typename R, std::enable_if_t<std::is_arithmetic<S>::value                              \
+		&& FTExpressionTraits<R>::bIsExpression, int> = 0>                                                       \
+	__forceinline auto Operator(const S Lhs, const R& Rhs) noexcept                                              \
+	{                                                                                                            \
+		using V = FTScalarType<typename FTExpressionType<R>::ValueType, S>;                                     \
+		return FTMakeBinaryExpression<Op>(FTScalarTerminal<V>(static_cast<V>(Lhs)), Rhs);                        \
+	}
+
+FT_DEFINE_EXPRESSION_OPERATOR(operator+, FTOpAdd)
+FT_DEFINE_EXPRESSION_OPERATOR(operator-, FTOpSubtract)
+FT_DEFINE_EXPRESSION_OPERATOR(operator*, FTOpMultiply)
+FT_DEFINE_EXPRESSION_OPERATOR(operator/, FTOpDivide)
+
+#undef FT_DEFINE_EXPRESSION_OPERATOR
+
+template<typename E, std::enable_if_t<FTExpressionTraits<E>::bIsExpression, int> = 0>
+__forceinline auto operator-(const E& Operand) noexcept
+{
+	return FTUnaryExpression<FTExpressionType<E>, FTOpNegate>(FTExpressionTraits<E>::Make(Operand));
+}
+
+/*
+ * Reductions run over the expression in a single pass, the four independent accumulators
+ * break the add dependency chain so the loop isn't bound by the latency of a single add
+ * Plain arrays go straight to the vectorized FTReduce kernels, integers are summed in 64 bits
+ */
+template<typename E, std::enable_if_t<FTExpressionTraits<E>::bIsExpression, int> = 0>
+__forceinline auto Sum(const E& Expr) noexcept
+{
+	const FTExpressionType<E>& Node = FTExpressionTraits<E>::Make(Expr);
+	using V = typename FTExpressionType<E>::ValueType;
+	using A = typename FTReduce<V>::SumType;
+
+	const int nSize = Node.GetSize();
+	FT_ASSERT(nSize != FT_INVALID_INDEX);
+
+	if constexpr (std::is_same<FTExpressionType<E>, FTArrayTerminal<V>>::value)
+		return FTReduce<V>::Sum(Node.GetData(), nSize);
+	else
+	{
+		A Acc0 = A(), Acc1 = A(), Acc2 = A(), Acc3 = A();
+
+		int i = 0;
+		for (; i + 4 <= nSize; i += 4)
+		{
+			Acc0 += Node[i];
+			Acc1 += Node[i + 1];
+			Acc2 += Node[i + 2];
+			Acc3 += Node[i + 3];
+		}
+
+		for (; i < nSize; i++)
+			Acc0 += Node[i];
+
+		return (Acc0 + Acc1) + (Acc2 + Acc3);
+	}
+}
+
+template<typename L, typename R, std::enable_if_t<FTExpressionTraits<L>::bIsExpression
+	&& FTExpressionTraits<R>::bIsExpression, int> = 0>
+__forceinline auto Dot(const L& Lhs, const R& Rhs) noexcept
+{
+	return Sum(FTMakeBinaryExpression<FTOpMultiply>(Lhs, Rhs));
+}
+
+// Euclidean norm, the expression is only evaluated once per element
+template<typename E, std::enable_if_t<FTExpressionTraits<E>::bIsExpression, int> = 0>
+__forceinline auto Norm(const E& Expr) noexcept
+{
+	const FTExpressionType<E>& Node = FTExpressionTraits<E>::Make(Expr);
+	using V = typename FTExpressionType<E>::ValueType;
+	using A = std::conditional_t<std::is_floating_point<V>::value, V, double>;
+
+	const int nSize = Node.GetSize();
+	FT_ASSERT(nSize != FT_INVALID_INDEX);
+
+	A Acc0 = A(), Acc1 = A(), Acc2 = A(), Acc3 = A();
+
+	int i = 0;
+	for (; i + 4 <= nSize; i += 4)
+	{
+		const A a0 = static_cast<A>(Node[i]);
+		const A a1 = static_cast<A>(Node[i + 1]);
+		const A a2 = static_cast<A>(Node[i + 2]);
+		const A a3 = static_cast<A>(Node[i + 3]);
+
+		Acc0 += a0 * a0;
+		Acc1 += a1 * a1;
+		Acc2 += a2 * a2;
+		Acc3 += a3 * a3;
+	}
+
+	for (; i < nSize; i++)
+	{
+		const A a = static_cast<A>(Node[i]);
+		Acc0 += a * a;
+	}
+
+	return std::sqrt((Acc0 + Acc1) + (Acc2 + Acc3));
+}
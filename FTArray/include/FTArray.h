@@ -1,4 +1,5 @@
 #pragma once
+#include <climits>
 #include <random>
 #include <thread>
 #include <vector>
@@ -6,7 +7,11 @@
 #include <type_traits>
 
 #include "ArrayIterator.h"
+#include "Expression.h"
 #include "Memory.h"
+#include "Reduce.h"
+#include "Select.h"
+#include "Serialize.h"
 #include "Globals.h"
 
 template<typename T>
@@ -50,6 +55,27 @@ class FTArray
 		return nIndex;
 	}
 
+	// Evaluates an expression tree in one pass, straight into our own memory
+	template<typename E>
+	__forceinline void Evaluate(const E& Expr) noexcept
+	{
+		static_assert(std::is_arithmetic<T>::value, "Expressions are only supported for numbers");
+
+		const int nSize = Expr.GetSize();
+		FT_ASSERT(nSize != FT_INVALID_INDEX);
+
+		// When this array is part of the expression its capacity already covers nSize,
+		// so we never reallocate memory the expression is still reading from
+		if (nSize > m_Memory.GetAllocationCount())
+			m_Memory.EnsureCapacity(nSize, 0);
+
+		m_nSize = nSize;
+
+		T* pDest = GetBase();
+		for (int i = 0; i < nSize; i++)
+			pDest[i] = static_cast<T>(Expr[i]);
+	}
+
 public:
 	__forceinline explicit FTArray(FTArray<T>& Other) noexcept
 	{
@@ -60,6 +86,19 @@ public:
 		m_bIsNumeric = std::is_arithmetic<T>();
 	}
 
+	__forceinline FTArray(FTArray<T>&& Other) noexcept
+	{
+		m_Memory = Other.m_Memory;
+		m_nSize = Other.m_nSize;
+		m_pElements = Other.m_pElements;
+
+		Other.m_Memory = FTMemory<T>();
+		Other.m_nSize = 0;
+		Other.m_pElements = nullptr;
+
+		m_bIsNumeric = std::is_arithmetic<T>();
+	}
+
 	__forceinline FTArray(std::initializer_list<T> List) noexcept
 	{
 		for (auto Item : List)
@@ -68,6 +107,13 @@ public:
 		m_bIsNumeric = std::is_arithmetic<T>();
 	}
 
+	template<typename E>
+	__forceinline FTArray(const FTExpression<E>& Expr) noexcept
+	{
+		m_bIsNumeric = std::is_arithmetic<T>();
+		Evaluate(Expr.Self());
+	}
+
 	__forceinline T* GetBase() noexcept
 	{
 		return m_Memory.Base();
@@ -100,30 +146,33 @@ public:
 
 	__forceinline FTArray<T>& operator=(const FTArray<T>& Other) noexcept
 	{
-		if (this == Other)
+		if (this == &Other)
 			return *this;
 
-		// Deallocate current memory
+		// Destruct current elements, the memory itself is reused when it's big enough
 		for (int i = 0; i < m_nSize; i++)
 		{
 			Destruct(&At(i));
 		}
 
 		m_nSize = 0;
-		m_Memory.Purge();
-		m_pElements = nullptr;
 
-		// Allocate new memory
+		m_Memory.EnsureCapacity(Other.GetSize(), 0);
 		m_nSize = Other.GetSize();
-		m_pElements = m_Memory.Alloc(m_nSize);
+		m_pElements = m_Memory.Base();
 
-		// Copy construct elements
-		for (int i = 0; i < m_nSize; i++)
-			CopyConstruct(&At(i), Other.At(i));
+		CopyElements(GetBase(), Other.GetBase(), m_nSize);
 
 		return *this;
 	}
 
+	template<typename E>
+	__forceinline FTArray<T>& operator=(const FTExpression<E>& Expr) noexcept
+	{
+		Evaluate(Expr.Self());
+		return *this;
+	}
+
 	__forceinline bool IsValidIndex(const unsigned int nIndex) const noexcept
 	{
 		return nIndex < static_cast<unsigned int>(m_nSize);
@@ -142,10 +191,11 @@ public:
 
 		if (nNum == 1 && m_bIsNumeric)
 		{
-			const int* pSrc = static_cast<int*>(&At(nIndex));
-			int* pDest = static_cast<int*>(&At(nIndex + nNum));
+			// Ranges overlap, copy from the back so we don't overwrite what we still have to move
+			const T* pSrc = &At(nIndex) + nNumToMove;
+			T* pDest = &At(nIndex + nNum) + nNumToMove;
 			for (int i = 0; i < nNumToMove; ++i)
-				*pDest++ = *pSrc++;
+				*--pDest = *--pSrc;
 		}
 		else
 			memmove(&At(nIndex + nNum), &At(nIndex), nNumToMove * sizeof(T));
@@ -164,8 +214,8 @@ public:
 
 		if (nNum == 1 && m_bIsNumeric)
 		{
-			const int* pSrc = static_cast<int*>(&At(nIndex + nNum));
-			int* pDest = static_cast<int*>(&At(nIndex));
+			const T* pSrc = &At(nIndex + nNum);
+			T* pDest = &At(nIndex);
 			for (int i = 0; i < nNumToMove; ++i)
 				*pDest++ = *pSrc++;
 		}
@@ -177,7 +227,7 @@ public:
 	{
 		const int nNewSize = m_nSize + nNum;
 		if (nNewSize > m_Memory.GetAllocationCount())
-			m_Memory.Grow(nNewSize - m_Memory.GetAllocationCount());
+			m_Memory.Grow(nNewSize - m_Memory.GetAllocationCount(), true, m_nSize);
 
 		m_nSize = nNewSize;
 	}
@@ -212,6 +262,36 @@ public:
 		return InsertBefore(m_nSize, Src);
 	}
 
+	__forceinline int AddBack(const T* pSrc, const int nNum) noexcept
+	{
+		return InsertRange(m_nSize, pSrc, nNum);
+	}
+
+	// Inserts nNum elements from pSrc before nIndex, pSrc must not point into this array
+	__forceinline int InsertRange(const int nIndex, const T* pSrc, const int nNum) noexcept
+	{
+		FT_ASSERT(nIndex == GetSize() || IsValidIndex(nIndex));
+		FT_ASSERT(nNum >= 0);
+
+		if (nNum <= 0)
+			return nIndex;
+
+		Grow(nNum);
+		ShiftRight(nIndex, nNum);
+
+		CopyElements(&At(nIndex), pSrc, nNum);
+
+		return nIndex;
+	}
+
+	// Deep copy, the shallow FTArray(FTArray&) constructor shares memory instead
+	__forceinline FTArray<T> Clone() const noexcept
+	{
+		FTArray<T> Copy = {};
+		Copy = *this;
+		return Copy;
+	}
+
 	__forceinline int RemoveBack() noexcept
 	{
 		return Remove(m_nSize);
@@ -240,6 +320,14 @@ public:
 		m_nSize--;
 	}
 
+	__forceinline void RemoveAll() noexcept
+	{
+		for (int i = 0; i < m_nSize; i++)
+			Destruct(&At(i));
+
+		m_nSize = 0;
+	}
+
 	__forceinline FTArrayIterator<T> Begin() noexcept
 	{
 		return FTArrayIterator<T>(GetBase());
@@ -378,7 +466,202 @@ public:
 		QuickSort(0, GetSize() - 1);
 	}
 
+	__forceinline auto Sum() const noexcept
+	{
+		return FTReduce<T>::Sum(GetBase(), GetSize());
+	}
+
+	__forceinline auto Sum(const int nNumThreads) const noexcept
+	{
+		return FTReduce<T>::Sum(GetBase(), GetSize(), nNumThreads);
+	}
+
+	__forceinline auto SumCompensated() const noexcept
+	{
+		return FTReduce<T>::SumCompensated(GetBase(), GetSize());
+	}
+
+	/*
+	 * Min, Max and MinMax give T() for an empty array. If the array holds NaNs the result is
+	 * unspecified, it may or may not be NaN depending on where the NaNs are and on the CPU
+	 */
+	__forceinline T Min() const noexcept
+	{
+		return FTReduce<T>::Min(GetBase(), GetSize());
+	}
+
+	__forceinline T Max() const noexcept
+	{
+		return FTReduce<T>::Max(GetBase(), GetSize());
+	}
+
+	__forceinline void MinMax(T& Min, T& Max) const noexcept
+	{
+		FTReduce<T>::MinMax(GetBase(), GetSize(), Min, Max);
+	}
+
+	/*
+	 * FT_INVALID_INDEX only for an empty array, otherwise always a valid index
+	 * With NaNs in the array which of the values is picked is unspecified, like for Min/Max
+	 */
+	__forceinline int ArgMin() const noexcept
+	{
+		return FTReduce<T>::ArgMin(GetBase(), GetSize());
+	}
+
+	__forceinline int ArgMax() const noexcept
+	{
+		return FTReduce<T>::ArgMax(GetBase(), GetSize());
+	}
+
+	// Scans run in place
+	__forceinline void InclusiveScan() noexcept
+	{
+		FTReduce<T>::InclusiveScan(GetBase(), GetBase(), GetSize());
+	}
+
+	__forceinline void InclusiveScan(const int nNumThreads) noexcept
+	{
+		FTReduce<T>::InclusiveScan(GetBase(), GetBase(), GetSize(), nNumThreads);
+	}
+
+	__forceinline void ExclusiveScan(const T Init = T()) noexcept
+	{
+		FTReduce<T>::ExclusiveScan(GetBase(), GetBase(), GetSize(), Init);
+	}
+
+	__forceinline void ExclusiveScan(const T Init, const int nNumThreads) noexcept
+	{
+		FTReduce<T>::ExclusiveScan(GetBase(), GetBase(), GetSize(), Init, nNumThreads);
+	}
+
+	template<typename Compare = std::less<T>>
+	__forceinline void NthElement(const int nNth, Compare Comp = Compare()) noexcept
+	{
+		FTSelect<T>::NthElement(GetBase(), GetSize(), nNth, Comp);
+	}
+
+	template<typename Compare = std::less<T>>
+	__forceinline void PartialSort(const int nK, Compare Comp = Compare()) noexcept
+	{
+		FTSelect<T>::PartialSort(GetBase(), GetSize(), nK, Comp);
+	}
+
+	/*
+	 * Replaces the contents of Out with the nK best values, best first (largest by default)
+	 * The values are collected before Out is touched, so Out may be this array
+	 */
+	template<typename Compare = std::greater<T>>
+	__forceinline void TopK(const int nK, FTArray<T>& Out, Compare Comp = Compare()) const noexcept
+	{
+		std::vector<T> Values(static_cast<size_t>(nK > 0 ? nK : 0));
+		const int nFound = FTSelect<T>::TopK(GetBase(), GetSize(), nK, Values.data(), Comp);
+
+		Out.RemoveAll();
+		Out.AddBack(Values.data(), nFound);
+	}
+
+	template<typename Compare = std::greater<T>>
+	__forceinline void TopK(const int nK, FTArray<T>& Out, const int nNumThreads, Compare Comp = Compare()) const noexcept
+	{
+		std::vector<T> Values(static_cast<size_t>(nK > 0 ? nK : 0));
+		const int nFound = FTSelect<T>::ParallelTopK(GetBase(), GetSize(), nK, Values.data(), nNumThreads, Comp);
+
+		Out.RemoveAll();
+		Out.AddBack(Values.data(), nFound);
+	}
+
+	template<typename Compare = std::greater<T>>
+	__forceinline void TopKIndices(const int nK, FTArray<int>& Out, Compare Comp = Compare()) const noexcept
+	{
+		std::vector<int> Indices(static_cast<size_t>(nK > 0 ? nK : 0));
+		const int nFound = FTSelect<T>::TopKIndices(GetBase(), GetSize(), nK, Indices.data(), Comp);
+
+		Out.RemoveAll();
+		for (int i = 0; i < nFound; i++)
+			Out.AddBack(Indices[i]);
+	}
+
+	template<typename Compare = std::greater<T>>
+	__forceinline void TopKIndices(const int nK, FTArray<int>& Out, const int nNumThreads, Compare Comp = Compare()) const noexcept
+	{
+		std::vector<int> Indices(static_cast<size_t>(nK > 0 ? nK : 0));
+		const int nFound = FTSelect<T>::ParallelTopKIndices(GetBase(), GetSize(), nK, Indices.data(), nNumThreads, Comp);
+
+		Out.RemoveAll();
+		for (int i = 0; i < nFound; i++)
+			Out.AddBack(Indices[i]);
+	}
+
+	/*
+	 * Writes the whole array with large writes straight from our memory, see Serialize.h for the format
+	 * nFd is put into binary mode (_O_BINARY) and stays that way
+	 */
+	__forceinline bool SaveTo(const int nFd) const noexcept
+	{
+		FTArrayStreamWriter<T> Writer(nFd, static_cast<unsigned long long>(GetSize()));
+		return Writer.Write(GetBase(), GetSize()) && Writer.Finish();
+	}
+
+	// Replaces the contents, on failure the array is left empty. nFd is put into binary mode like in SaveTo
+	__forceinline bool LoadFrom(const int nFd) noexcept
+	{
+		m_nSize = 0;
+
+		FTArrayStreamReader<T> Reader(nFd);
+		if (!Reader.IsValid() || Reader.GetCount() > static_cast<unsigned long long>(INT_MAX))
+			return false;
+
+		const int nCount = static_cast<int>(Reader.GetCount());
+		const int nChunkNum = static_cast<int>((FT_SERIALIZE_CHUNK_SIZE + sizeof(T) - 1) / sizeof(T));
+
+		// The header count isn't trusted with an allocation, memory grows with the data actually read
+		int nRead = 0;
+		while (nRead < nCount)
+		{
+			const int nNum = (nCount - nRead < nChunkNum) ? nCount - nRead : nChunkNum;
+
+			if (nRead + nNum > m_Memory.GetAllocationCount())
+			{
+				// Doubling, capped at the header count
+				int nWanted = (m_Memory.GetAllocationCount() <= nCount / 2) ? m_Memory.GetAllocationCount() * 2 : nCount;
+				if (nWanted < nRead + nNum)
+					nWanted = nRead + nNum;
+
+				m_Memory.EnsureCapacity(nWanted, nRead);
+				if (m_Memory.GetAllocationCount() < nRead + nNum)
+					return false;
+			}
+
+			if (Reader.Read(GetBase() + nRead, nNum) != nNum)
+				return false;
+
+			nRead += nNum;
+		}
+
+		if (!Reader.Finish())
+			return false;
+
+		m_nSize = nCount;
+		return true;
+	}
+
 private:
+	// Copy constructs nNum elements into uninitialized memory, large trivial copies go through FTCopy
+	static __forceinline void CopyElements(T* pDest, const T* pSrc, const int nNum) noexcept
+	{
+		if (nNum <= 0)
+			return;
+
+		if constexpr (std::is_trivially_copyable<T>::value)
+			FTCopy::Copy(pDest, pSrc, static_cast<size_t>(nNum) * sizeof(T));
+		else
+		{
+			for (int i = 0; i < nNum; i++)
+				CopyConstruct(pDest + i, pSrc[i]);
+		}
+	}
+
 	FTMemory<T> m_Memory;
 	int m_nSize = 0;
 	T* m_pElements = nullptr;
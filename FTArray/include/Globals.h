@@ -23,3 +23,9 @@ constexpr int FT_ALLOC_SIZE_PRIME = 31;
 #else
 constexpr int FT_ALLOC_SIZE_PRIME = 29;
 #endif
+
+// Used to keep data written by different threads on separate cache lines
+constexpr int FT_CACHE_LINE_SIZE = 64;
+
+// FTMemory never aligns below this, enough for any SSE load or store
+constexpr int FT_MEMORY_MIN_ALIGNMENT = 16;
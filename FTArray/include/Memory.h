@@ -1,11 +1,17 @@
 #pragma once
 #include <Windows.h>
+#include <type_traits>
 
+#include "Copy.h"
 #include "Globals.h"
 
 template<typename T>
 class FTMemory
 {
+	// _aligned_malloc needs a power of two, which alignof always is (unlike sizeof)
+	static constexpr size_t s_nAlignment = (alignof(T) > static_cast<size_t>(FT_MEMORY_MIN_ALIGNMENT))
+		? alignof(T) : static_cast<size_t>(FT_MEMORY_MIN_ALIGNMENT);
+
 public:
 
 	__forceinline explicit FTMemory(const int nGrowSize = 0, const int nInitialAllocationCount = 0) noexcept
@@ -15,7 +21,7 @@ public:
 
 		if (m_nAllocationCount)
 			m_pMemory = static_cast<T*>(_aligned_malloc(static_cast<size_t>(m_nAllocationCount) 
-				* sizeof(T), sizeof(T)));
+				* sizeof(T), s_nAlignment));
 	}
 
 	class Iterator
@@ -142,7 +148,7 @@ public:
 				const int nNewAllocationCount = (nAllocationCount >> 3)
 					+ (nAllocationCount >> 4) + nAllocationCount; // 1/8 + 1/16 + 1 = 1.3125
 
-				nAllocationCount = (nNewAllocationCount < nAllocationCount)
+				nAllocationCount = (nNewAllocationCount <= nAllocationCount)
 					? (nAllocationCount << 1) : nNewAllocationCount;
 			}
 		}
@@ -150,7 +156,9 @@ public:
 		return nAllocationCount;
 	}
 
-	__forceinline void Grow(const int nNum, const bool bUsePowerOfTwoGrowth = true) noexcept
+	// nNumInUse is how many elements at the front have to be kept, FT_INVALID_INDEX keeps the whole allocation
+	__forceinline void Grow(const int nNum, const bool bUsePowerOfTwoGrowth = true,
+		const int nNumInUse = FT_INVALID_INDEX) noexcept
 	{
 		FT_ASSERT(nNum > 0);
 
@@ -183,20 +191,10 @@ public:
 			}
 		}
 
-		m_nAllocationCount = nNewAllocationCount;
-
-		T* pNewMemory;
-		if (m_pMemory)
-			pNewMemory = static_cast<T*>(_aligned_realloc(m_pMemory, static_cast<size_t>(m_nAllocationCount) * sizeof(T), sizeof(T)));
-		else
-			pNewMemory = static_cast<T*>(_aligned_malloc(static_cast<size_t>(m_nAllocationCount) * sizeof(T), sizeof(T)));
-
-		FT_ASSERT(pNewMemory == nullptr);
-
-		m_pMemory = pNewMemory;
+		Relocate(nNewAllocationCount, nNumInUse);
 	}
 
-	__forceinline void EnsureCapacity(const int nNum) noexcept
+	__forceinline void EnsureCapacity(const int nNum, const int nNumInUse = FT_INVALID_INDEX) noexcept
 	{
 		if (m_nAllocationCount >= nNum)
 			return;
@@ -208,17 +206,7 @@ public:
 			return;
 		}
 
-		m_nAllocationCount = nNum;
-
-		T* pNewMemory;
-		if (m_pMemory)
-			pNewMemory = static_cast<T*>(_aligned_realloc(m_pMemory, static_cast<size_t>(m_nAllocationCount) * sizeof(T), sizeof(T)));
-		else
-			pNewMemory = static_cast<T*>(_aligned_malloc(static_cast<size_t>(m_nAllocationCount) * sizeof(T), sizeof(T)));
-
-		FT_ASSERT(pNewMemory == nullptr);
-
-		m_pMemory = pNewMemory;
+		Relocate(nNum, nNumInUse);
 	}
 
 	__forceinline void Purge() noexcept
@@ -272,14 +260,59 @@ public:
 
 		m_nAllocationCount = nCount;
 
-		T* pNewMemory = static_cast<T*>(_aligned_realloc(m_pMemory, static_cast<size_t>(m_nAllocationCount) * sizeof(T), sizeof(T)));
+		T* pNewMemory = static_cast<T*>(_aligned_realloc(m_pMemory, static_cast<size_t>(m_nAllocationCount) * sizeof(T), s_nAlignment));
 
-		FT_ASSERT(pNewMemory == nullptr);
+		FT_ASSERT(pNewMemory != nullptr);
 
 		m_pMemory = pNewMemory;
 	}
 
 private:
+	/*
+	 * Grows the allocation to nNewAllocationCount elements, keeping the first nNumInUse
+	 * If the allocation fails the old memory and allocation count are left untouched
+	 */
+	__forceinline void Relocate(const int nNewAllocationCount, const int nNumInUse) noexcept
+	{
+		const size_t nUsedBytes = static_cast<size_t>((nNumInUse == FT_INVALID_INDEX) ? m_nAllocationCount : nNumInUse) * sizeof(T);
+		const size_t nNewBytes = static_cast<size_t>(nNewAllocationCount) * sizeof(T);
+
+		T* pNewMemory;
+		if (!m_pMemory)
+			pNewMemory = static_cast<T*>(_aligned_malloc(nNewBytes, s_nAlignment));
+		else if (nNumInUse == 0)
+		{
+			// Nothing to keep, realloc would copy the whole old block for nothing
+			pNewMemory = static_cast<T*>(_aligned_malloc(nNewBytes, s_nAlignment));
+			if (pNewMemory)
+				_aligned_free(m_pMemory);
+		}
+		else if (std::is_trivially_copyable<T>::value && nUsedBytes >= FTCopy::GetNonTemporalThreshold())
+		{
+			/*
+			 * This gives up on _aligned_realloc extending the block in place, but when it can't, it copies
+			 * the whole old block through the cache. A fresh block with only the used elements streamed
+			 * into it keeps a move of this size from flushing everything else out
+			 */
+			pNewMemory = static_cast<T*>(_aligned_malloc(nNewBytes, s_nAlignment));
+			if (pNewMemory)
+			{
+				FTCopy::CopyNonTemporal(pNewMemory, m_pMemory, nUsedBytes);
+				_aligned_free(m_pMemory);
+			}
+		}
+		else
+			pNewMemory = static_cast<T*>(_aligned_realloc(m_pMemory, nNewBytes, s_nAlignment));
+
+		FT_ASSERT(pNewMemory != nullptr);
+
+		if (!pNewMemory)
+			return;
+
+		m_pMemory = pNewMemory;
+		m_nAllocationCount = nNewAllocationCount;
+	}
+
 	T* m_pMemory = nullptr;
 	int m_nGrowSize = 0;
 	int m_nAllocationCount = 0;
@@ -0,0 +1,553 @@
+#pragma once
+#include <cstring>
+#include <utility>
+#include <type_traits>
+#include <emmintrin.h>
+
+#include "FTArray.h"
+#include "Memory.h"
+#include "Reduce.h"
+#include "Globals.h"
+
+constexpr int FT_PACKED_BLOCK_SHIFT = 7;
+constexpr int FT_PACKED_BLOCK_SIZE = 1 << FT_PACKED_BLOCK_SHIFT; // 128 values per block
+
+// Delta blocks keep the decoded value every 32 positions so At never sums more than 16 deltas
+constexpr int FT_PACKED_ANCHOR_SHIFT = 5;
+constexpr int FT_PACKED_ANCHOR_COUNT = (FT_PACKED_BLOCK_SIZE >> FT_PACKED_ANCHOR_SHIFT) - 1;
+
+enum class FTPackedCodec : unsigned char
+{
+	FrameOfReference,	// Value - block minimum
+	Delta				// Value - previous value, only used for non-decreasing blocks
+};
+
+template<typename T>
+struct FTPackedBlock
+{
+	T Base;				// Block minimum for frame of reference, first value for delta
+	T Min;
+	T Max;
+	T Anchors[FT_PACKED_ANCHOR_COUNT];	// Delta only, the values at positions 32, 64 and 96
+	int nWordOffset;	// A block of width w always takes exactly 4 * w 32-bit words (128 * w bits)
+	unsigned char nBitWidth;
+	FTPackedCodec Codec;
+};
+
+/*
+ * Bit layout of one block of 128 values packed at nBitWidth <= 32
+ * Value i goes to lane i % 4 at position i / 4, each lane is a bit stream of 32 * nBitWidth bits and
+ * the lanes' 32-bit words are interleaved, so word k of every lane together is one 16 byte vector
+ * Unpacking then works on all four lanes at once with plain SSE2 shifts, and every vector it produces
+ * holds four consecutive values. Wider values (64-bit types only) store their low 32 bits as a width
+ * 32 block followed by the remaining high bits as a second block
+ */
+class FTPackedLanes
+{
+public:
+	static constexpr int s_nMaxBitWidth = 32;
+
+	using UnpackFunction = void(*)(const unsigned int*, unsigned int*);
+
+	// pWords needs room for 4 * nBitWidth words, every value must fit in nBitWidth bits
+	static __forceinline void Pack(const unsigned int* pValues, const int nBitWidth, unsigned int* pWords) noexcept
+	{
+		memset(pWords, 0, static_cast<size_t>(nBitWidth) * 4 * sizeof(unsigned int));
+
+		for (int i = 0; i < FT_PACKED_BLOCK_SIZE; i++)
+		{
+			const int nBit = (i >> 2) * nBitWidth;
+			const int nWord = ((nBit >> 5) << 2) + (i & 3);
+			const int nShift = nBit & 31;
+			const unsigned long long Value = pValues[i];
+
+			pWords[nWord] |= static_cast<unsigned int>(Value << nShift);
+			if (nShift + nBitWidth > 32)
+				pWords[nWord + 4] |= static_cast<unsigned int>(Value >> (32 - nShift));
+		}
+	}
+
+	// Random access to a single value, nBitWidth has to be at least 1
+	static __forceinline unsigned int Extract(const unsigned int* pWords, const int nPosition,
+		const int nBitWidth) noexcept
+	{
+		const int nBit = (nPosition >> 2) * nBitWidth;
+		const int nWord = ((nBit >> 5) << 2) + (nPosition & 3);
+		const int nShift = nBit & 31;
+
+		unsigned long long Value = static_cast<unsigned long long>(pWords[nWord]) >> nShift;
+		if (nShift + nBitWidth > 32)
+			Value |= static_cast<unsigned long long>(pWords[nWord + 4]) << (32 - nShift);
+
+		return static_cast<unsigned int>(Value & (~0ull >> (64 - nBitWidth)));
+	}
+
+	/*
+	 * One unpacker per bit width, each step shifts the current word of all four lanes down and
+	 * pulls in the low bits of the next word when a value straddles the two
+	 */
+	template<int nBitWidth>
+	static void Unpack(const unsigned int* pWords, unsigned int* pOut) noexcept
+	{
+		__m128i* pOutVectors = reinterpret_cast<__m128i*>(pOut);
+
+		if constexpr (nBitWidth == 0)
+		{
+			for (int i = 0; i < FT_PACKED_BLOCK_SIZE / 4; i++)
+				_mm_storeu_si128(pOutVectors + i, _mm_setzero_si128());
+		}
+		else
+		{
+			const __m128i* pInVectors = reinterpret_cast<const __m128i*>(pWords);
+			const __m128i Mask = _mm_set1_epi32(static_cast<int>(~0u >> (32 - nBitWidth)));
+
+			__m128i Current = _mm_loadu_si128(pInVectors++);
+			int nShift = 0;
+
+			for (int i = 0; i < FT_PACKED_BLOCK_SIZE / 4; i++)
+			{
+				__m128i Value = _mm_srli_epi32(Current, nShift);
+
+				nShift += nBitWidth;
+				if (nShift >= 32)
+				{
+					nShift -= 32;
+
+					// Each lane is exactly nBitWidth words long, the last value never needs another load
+					if (i != FT_PACKED_BLOCK_SIZE / 4 - 1)
+					{
+						Current = _mm_loadu_si128(pInVectors++);
+						if (nShift)
+							Value = _mm_or_si128(Value, _mm_slli_epi32(Current, nBitWidth - nShift));
+					}
+				}
+
+				_mm_storeu_si128(pOutVectors + i, _mm_and_si128(Value, Mask));
+			}
+		}
+	}
+
+	static __forceinline UnpackFunction GetUnpacker(const int nBitWidth) noexcept
+	{
+		return GetUnpacker(nBitWidth, std::make_index_sequence<s_nMaxBitWidth + 1>());
+	}
+
+private:
+	template<size_t... nBitWidths>
+	static __forceinline UnpackFunction GetUnpacker(const int nBitWidth, std::index_sequence<nBitWidths...>) noexcept
+	{
+		static constexpr UnpackFunction s_Unpackers[] = { &Unpack<static_cast<int>(nBitWidths)>... };
+		return s_Unpackers[nBitWidth];
+	}
+};
+
+/*
+ * Append-only compressed storage for integer columns
+ * Full blocks of 128 values are bit-packed at the smallest width that fits, either relative to
+ * the block minimum or as deltas for sorted runs (ids, timestamps), the last partial block stays
+ * uncompressed until it fills up. Block headers keep Min/Max so Find can skip blocks entirely
+ */
+template<typename T>
+class FTPackedArray
+{
+	static_assert(std::is_integral<T>::value, "FTPackedArray only supports integer types");
+
+	using UnsignedType = std::make_unsigned_t<T>;
+
+	static constexpr int s_nMaxBitWidth = static_cast<int>(sizeof(T) * 8);
+
+public:
+	using SumType = typename FTReduce<T>::SumType;
+
+	__forceinline FTPackedArray() noexcept = default;
+
+	__forceinline explicit FTPackedArray(const FTArray<T>& Array) noexcept
+	{
+		AddBack(Array.GetBase(), Array.GetSize());
+	}
+
+	FTPackedArray(const FTPackedArray<T>&) = delete;
+	FTPackedArray<T>& operator=(const FTPackedArray<T>&) = delete;
+
+	__forceinline ~FTPackedArray() noexcept
+	{
+		m_Words.Purge();
+		m_Blocks.Purge();
+	}
+
+	__forceinline void AddBack(const T Value) noexcept
+	{
+		m_Pending[m_nPendingCount++] = Value;
+		m_nSize++;
+
+		if (m_nPendingCount == FT_PACKED_BLOCK_SIZE)
+		{
+			EncodeBlock(m_Pending);
+			m_nPendingCount = 0;
+		}
+	}
+
+	__forceinline void AddBack(const T* pValues, int nCount) noexcept
+	{
+		FT_ASSERT(nCount >= 0);
+
+		while (nCount > 0)
+		{
+			// Whole blocks are encoded straight from the source, no staging copy
+			if (m_nPendingCount == 0 && nCount >= FT_PACKED_BLOCK_SIZE)
+			{
+				EncodeBlock(pValues);
+				pValues += FT_PACKED_BLOCK_SIZE;
+				nCount -= FT_PACKED_BLOCK_SIZE;
+				m_nSize += FT_PACKED_BLOCK_SIZE;
+				continue;
+			}
+
+			const int nNum = (FT_PACKED_BLOCK_SIZE - m_nPendingCount < nCount)
+				? FT_PACKED_BLOCK_SIZE - m_nPendingCount : nCount;
+
+			memcpy(&m_Pending[m_nPendingCount], pValues, static_cast<size_t>(nNum) * sizeof(T));
+			m_nPendingCount += nNum;
+			m_nSize += nNum;
+			pValues += nNum;
+			nCount -= nNum;
+
+			if (m_nPendingCount == FT_PACKED_BLOCK_SIZE)
+			{
+				EncodeBlock(m_Pending);
+				m_nPendingCount = 0;
+			}
+		}
+	}
+
+	/*
+	 * Frame of reference blocks are O(1). Delta blocks start from the nearest known value, the first
+	 * value, an anchor or the last value (which is Max, delta blocks are non-decreasing), and add or
+	 * subtract the deltas in between
+	 */
+	__forceinline T At(const int nIndex) const noexcept
+	{
+		FT_ASSERT(IsValidIndex(nIndex));
+
+		const int nBlock = nIndex >> FT_PACKED_BLOCK_SHIFT;
+		const int nOffset = nIndex & (FT_PACKED_BLOCK_SIZE - 1);
+
+		if (nBlock == m_nBlockCount)
+			return m_Pending[nOffset];
+
+		const FTPackedBlock<T>& Block = m_Blocks[nBlock];
+		const int nBitWidth = Block.nBitWidth;
+
+		if (!nBitWidth)
+			return Block.Base;
+
+		const unsigned int* pWords = m_Words.Base() + Block.nWordOffset;
+
+		if (Block.Codec == FTPackedCodec::FrameOfReference)
+		{
+			return static_cast<T>(static_cast<UnsignedType>(Block.Base)
+				+ static_cast<UnsignedType>(Extract(pWords, nOffset, nBitWidth)));
+		}
+
+		const int nAnchor = (nOffset + (1 << (FT_PACKED_ANCHOR_SHIFT - 1))) >> FT_PACKED_ANCHOR_SHIFT;
+
+		int nPosition;
+		UnsignedType Value;
+		if (nAnchor == 0)
+		{
+			nPosition = 0;
+			Value = static_cast<UnsignedType>(Block.Base);
+		}
+		else if (nAnchor > FT_PACKED_ANCHOR_COUNT)
+		{
+			nPosition = FT_PACKED_BLOCK_SIZE - 1;
+			Value = static_cast<UnsignedType>(Block.Max);
+		}
+		else
+		{
+			nPosition = nAnchor << FT_PACKED_ANCHOR_SHIFT;
+			Value = static_cast<UnsignedType>(Block.Anchors[nAnchor - 1]);
+		}
+
+		for (int i = nPosition + 1; i <= nOffset; i++)
+			Value += static_cast<UnsignedType>(Extract(pWords, i, nBitWidth));
+
+		for (int i = nPosition; i > nOffset; i--)
+			Value -= static_cast<UnsignedType>(Extract(pWords, i, nBitWidth));
+
+		return static_cast<T>(Value);
+	}
+
+	__forceinline T operator[](const int nIndex) const noexcept
+	{
+		return At(nIndex);
+	}
+
+	__forceinline bool IsValidIndex(const unsigned int nIndex) const noexcept
+	{
+		return nIndex < static_cast<unsigned int>(m_nSize);
+	}
+
+	__forceinline int GetSize() const noexcept
+	{
+		return m_nSize;
+	}
+
+	// Includes the trailing uncompressed block if there is one
+	__forceinline int GetBlockCount() const noexcept
+	{
+		return m_nBlockCount + (m_nPendingCount ? 1 : 0);
+	}
+
+	__forceinline size_t GetMemoryUsage() const noexcept
+	{
+		return static_cast<size_t>(m_Words.GetAllocationCount()) * sizeof(unsigned int)
+			+ static_cast<size_t>(m_Blocks.GetAllocationCount()) * sizeof(FTPackedBlock<T>)
+			+ sizeof(*this);
+	}
+
+	// Decodes a whole block into pOut (room for FT_PACKED_BLOCK_SIZE values), returns the value count
+	__forceinline int DecodeBlock(const int nBlock, T* pOut) const noexcept
+	{
+		FT_ASSERT(nBlock >= 0 && nBlock < GetBlockCount());
+
+		if (nBlock == m_nBlockCount)
+		{
+			memcpy(pOut, m_Pending, static_cast<size_t>(m_nPendingCount) * sizeof(T));
+			return m_nPendingCount;
+		}
+
+		const FTPackedBlock<T>& Block = m_Blocks[nBlock];
+
+		alignas(16) unsigned int Lanes[FT_PACKED_BLOCK_SIZE];
+		const unsigned int* pWords = m_Words.Base() + Block.nWordOffset;
+		const int nBitWidth = Block.nBitWidth;
+
+		// T and its unsigned counterpart may alias, widen in place and rebase afterwards
+		UnsignedType* pRaw = reinterpret_cast<UnsignedType*>(pOut);
+
+		FTPackedLanes::GetUnpacker(LowBitWidth(nBitWidth))(pWords, Lanes);
+		for (int i = 0; i < FT_PACKED_BLOCK_SIZE; i++)
+			pRaw[i] = static_cast<UnsignedType>(Lanes[i]);
+
+		if constexpr (s_nMaxBitWidth > FTPackedLanes::s_nMaxBitWidth)
+		{
+			if (nBitWidth > FTPackedLanes::s_nMaxBitWidth)
+			{
+				FTPackedLanes::GetUnpacker(nBitWidth - FTPackedLanes::s_nMaxBitWidth)(
+					pWords + 4 * FTPackedLanes::s_nMaxBitWidth, Lanes);
+
+				for (int i = 0; i < FT_PACKED_BLOCK_SIZE; i++)
+					pRaw[i] |= static_cast<UnsignedType>(Lanes[i]) << FTPackedLanes::s_nMaxBitWidth;
+			}
+		}
+
+		UnsignedType Base = static_cast<UnsignedType>(Block.Base);
+		if (Block.Codec == FTPackedCodec::FrameOfReference)
+		{
+			for (int i = 0; i < FT_PACKED_BLOCK_SIZE; i++)
+				pRaw[i] += Base;
+		}
+		else
+		{
+			for (int i = 0; i < FT_PACKED_BLOCK_SIZE; i++)
+			{
+				Base += pRaw[i];
+				pRaw[i] = Base;
+			}
+		}
+
+		return FT_PACKED_BLOCK_SIZE;
+	}
+
+	// Fn(const T* pValues, int nCount, int nFirstIndex) is called once per block, in order
+	template<typename Func>
+	__forceinline void ForEachBlock(Func Fn) const
+	{
+		T Buffer[FT_PACKED_BLOCK_SIZE];
+
+		const int nBlockCount = GetBlockCount();
+		for (int i = 0; i < nBlockCount; i++)
+		{
+			const int nCount = DecodeBlock(i, Buffer);
+			Fn(static_cast<const T*>(Buffer), nCount, i << FT_PACKED_BLOCK_SHIFT);
+		}
+	}
+
+	__forceinline int Find(const T& Value) const noexcept
+	{
+		T Buffer[FT_PACKED_BLOCK_SIZE];
+
+		for (int i = 0; i < m_nBlockCount; i++)
+		{
+			const FTPackedBlock<T>& Block = m_Blocks[i];
+			if (Value < Block.Min || Value > Block.Max)
+				continue;
+
+			DecodeBlock(i, Buffer);
+			for (int j = 0; j < FT_PACKED_BLOCK_SIZE; j++)
+			{
+				if (Buffer[j] == Value)
+					return (i << FT_PACKED_BLOCK_SHIFT) + j;
+			}
+		}
+
+		for (int j = 0; j < m_nPendingCount; j++)
+		{
+			if (m_Pending[j] == Value)
+				return (m_nBlockCount << FT_PACKED_BLOCK_SHIFT) + j;
+		}
+
+		return FT_INVALID_INDEX;
+	}
+
+	__forceinline SumType Sum() const noexcept
+	{
+		SumType Result = 0;
+
+		ForEachBlock([&](const T* pValues, const int nCount, int)
+			{
+				Result += FTReduce<T>::Sum(pValues, nCount);
+			});
+
+		return Result;
+	}
+
+private:
+	static __forceinline int CalcBitWidth(UnsignedType Value) noexcept
+	{
+		int nBitWidth = 0;
+		while (Value)
+		{
+			nBitWidth++;
+			Value >>= 1;
+		}
+
+		return nBitWidth;
+	}
+
+	static __forceinline int LowBitWidth(const int nBitWidth) noexcept
+	{
+		return (nBitWidth < FTPackedLanes::s_nMaxBitWidth) ? nBitWidth : FTPackedLanes::s_nMaxBitWidth;
+	}
+
+	static __forceinline UnsignedType Extract(const unsigned int* pWords, const int nPosition, const int nBitWidth) noexcept
+	{
+		UnsignedType Value = static_cast<UnsignedType>(FTPackedLanes::Extract(pWords, nPosition, LowBitWidth(nBitWidth)));
+
+		if constexpr (s_nMaxBitWidth > FTPackedLanes::s_nMaxBitWidth)
+		{
+			if (nBitWidth > FTPackedLanes::s_nMaxBitWidth)
+			{
+				Value |= static_cast<UnsignedType>(FTPackedLanes::Extract(pWords + 4 * FTPackedLanes::s_nMaxBitWidth,
+					nPosition, nBitWidth - FTPackedLanes::s_nMaxBitWidth)) << FTPackedLanes::s_nMaxBitWidth;
+			}
+		}
+
+		return Value;
+	}
+
+	__forceinline void EncodeBlock(const T* pValues) noexcept
+	{
+		T Min = pValues[0];
+		T Max = pValues[0];
+		UnsignedType MaxDelta = 0;
+		bool bSorted = true;
+
+		for (int i = 1; i < FT_PACKED_BLOCK_SIZE; i++)
+		{
+			const T Value = pValues[i];
+
+			if (Value < Min)
+				Min = Value;
+			if (Value > Max)
+				Max = Value;
+
+			if (Value < pValues[i - 1])
+				bSorted = false;
+			else
+			{
+				const UnsignedType Delta = static_cast<UnsignedType>(Value) - static_cast<UnsignedType>(pValues[i - 1]);
+				if (Delta > MaxDelta)
+					MaxDelta = Delta;
+			}
+		}
+
+		const int nRangeBitWidth = CalcBitWidth(static_cast<UnsignedType>(Max) - static_cast<UnsignedType>(Min));
+		const int nDeltaBitWidth = bSorted ? CalcBitWidth(MaxDelta) : s_nMaxBitWidth + 1;
+
+		FTPackedBlock<T> Block = {};
+		Block.Min = Min;
+		Block.Max = Max;
+		Block.nWordOffset = m_nWordCount;
+
+		if (nDeltaBitWidth < nRangeBitWidth)
+		{
+			Block.Codec = FTPackedCodec::Delta;
+			Block.Base = pValues[0];
+			Block.nBitWidth = static_cast<unsigned char>(nDeltaBitWidth);
+
+			for (int i = 0; i < FT_PACKED_ANCHOR_COUNT; i++)
+				Block.Anchors[i] = pValues[(i + 1) << FT_PACKED_ANCHOR_SHIFT];
+		}
+		else
+		{
+			Block.Codec = FTPackedCodec::FrameOfReference;
+			Block.Base = Min;
+			Block.nBitWidth = static_cast<unsigned char>(nRangeBitWidth);
+		}
+
+		const int nBitWidth = Block.nBitWidth;
+		const int nNumWords = nBitWidth * 4;
+
+		if (m_nWordCount + nNumWords > m_Words.GetAllocationCount())
+			m_Words.Grow(m_nWordCount + nNumWords - m_Words.GetAllocationCount());
+
+		if (m_nBlockCount + 1 > m_Blocks.GetAllocationCount())
+			m_Blocks.Grow(1);
+
+		if (nNumWords)
+		{
+			UnsignedType Raw[FT_PACKED_BLOCK_SIZE];
+			for (int i = 0; i < FT_PACKED_BLOCK_SIZE; i++)
+			{
+				Raw[i] = (Block.Codec == FTPackedCodec::Delta)
+					? static_cast<UnsignedType>(static_cast<UnsignedType>(pValues[i])
+						- static_cast<UnsignedType>(i ? pValues[i - 1] : pValues[0]))
+					: static_cast<UnsignedType>(static_cast<UnsignedType>(pValues[i]) - static_cast<UnsignedType>(Min));
+			}
+
+			unsigned int* pWords = m_Words.Base() + m_nWordCount;
+			unsigned int Lanes[FT_PACKED_BLOCK_SIZE];
+
+			for (int i = 0; i < FT_PACKED_BLOCK_SIZE; i++)
+				Lanes[i] = static_cast<unsigned int>(Raw[i]);
+
+			FTPackedLanes::Pack(Lanes, LowBitWidth(nBitWidth), pWords);
+
+			if constexpr (s_nMaxBitWidth > FTPackedLanes::s_nMaxBitWidth)
+			{
+				if (nBitWidth > FTPackedLanes::s_nMaxBitWidth)
+				{
+					for (int i = 0; i < FT_PACKED_BLOCK_SIZE; i++)
+						Lanes[i] = static_cast<unsigned int>(Raw[i] >> FTPackedLanes::s_nMaxBitWidth);
+
+					FTPackedLanes::Pack(Lanes, nBitWidth - FTPackedLanes::s_nMaxBitWidth,
+						pWords + 4 * FTPackedLanes::s_nMaxBitWidth);
+				}
+			}
+		}
+
+		m_Blocks[m_nBlockCount++] = Block;
+		m_nWordCount += nNumWords;
+	}
+
+	FTMemory<unsigned int> m_Words;
+	FTMemory<FTPackedBlock<T>> m_Blocks;
+	int m_nWordCount = 0;
+	int m_nBlockCount = 0;
+	int m_nSize = 0;
+
+	T m_Pending[FT_PACKED_BLOCK_SIZE] = {};
+	int m_nPendingCount = 0;
+};
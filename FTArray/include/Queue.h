@@ -0,0 +1,423 @@
+#pragma once
+#include <new>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+#include <immintrin.h>
+
+#include "Memory.h"
+#include "Globals.h"
+
+// Spins this many times before FTQueueWait::Yield starts giving up the time slice
+constexpr int FT_QUEUE_SPIN_COUNT = 64;
+
+enum class FTQueueWait
+{
+	Spin,	// Busy wait with pause, lowest latency but burns the core
+	Yield	// Spin briefly, then yield to other threads until the queue is ready
+};
+
+// Largest power of two an int can hold, the cells are indexed with int through FTMemory
+constexpr int FT_QUEUE_MAX_CAPACITY = 1 << 30;
+
+__forceinline int FTQueueCapacity(const int nCapacity) noexcept
+{
+	FT_ASSERT(nCapacity > 0 && nCapacity <= FT_QUEUE_MAX_CAPACITY);
+
+	// The bound also stops the shift from overflowing when asserts are compiled out
+	int nPowerOf2 = 1;
+	while (nPowerOf2 < nCapacity && nPowerOf2 < FT_QUEUE_MAX_CAPACITY)
+		nPowerOf2 <<= 1;
+
+	return nPowerOf2;
+}
+
+__forceinline void FTQueueBackoff(const FTQueueWait Wait, int& nSpins) noexcept
+{
+	if (Wait == FTQueueWait::Spin || ++nSpins < FT_QUEUE_SPIN_COUNT)
+		_mm_pause();
+	else
+		std::this_thread::yield();
+}
+
+/*
+ * Lock-free ring buffer for exactly one producer and one consumer thread
+ * Head and tail live on their own cache lines together with a cached copy of the other side's
+ * index, so each side only touches the other's line when the queue looks full or empty
+ */
+template<typename T>
+class FTSpscQueue
+{
+public:
+	// The capacity is rounded up to a power of two so wrapping is a mask instead of a division
+	__forceinline explicit FTSpscQueue(const int nCapacity, const FTQueueWait Wait = FTQueueWait::Spin) noexcept
+		: m_Memory(0, FTQueueCapacity(nCapacity)), m_nCapacity(FTQueueCapacity(nCapacity)), m_Wait(Wait)
+	{
+	}
+
+	FTSpscQueue(const FTSpscQueue<T>&) = delete;
+	FTSpscQueue<T>& operator=(const FTSpscQueue<T>&) = delete;
+
+	__forceinline ~FTSpscQueue() noexcept
+	{
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			const size_t nTail = m_nTail.load(std::memory_order_relaxed);
+			for (size_t i = m_nHead.load(std::memory_order_relaxed); i != nTail; i++)
+				Slot(i)->~T();
+		}
+
+		m_Memory.Purge();
+	}
+
+	__forceinline int GetCapacity() const noexcept
+	{
+		return m_nCapacity;
+	}
+
+	// Only exact when called from the producer or consumer thread while the other side is idle
+	__forceinline int GetSize() const noexcept
+	{
+		return static_cast<int>(m_nTail.load(std::memory_order_acquire) - m_nHead.load(std::memory_order_acquire));
+	}
+
+	__forceinline bool TryPush(const T& Src) noexcept
+	{
+		const size_t nTail = m_nTail.load(std::memory_order_relaxed);
+		if (!HasRoom(nTail, 1))
+			return false;
+
+		::new(Slot(nTail)) T(Src);
+		m_nTail.store(nTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	__forceinline bool TryPush(T&& Src) noexcept
+	{
+		const size_t nTail = m_nTail.load(std::memory_order_relaxed);
+		if (!HasRoom(nTail, 1))
+			return false;
+
+		::new(Slot(nTail)) T(std::move(Src));
+		m_nTail.store(nTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	__forceinline void Push(const T& Src) noexcept
+	{
+		int nSpins = 0;
+		while (!TryPush(Src))
+			FTQueueBackoff(m_Wait, nSpins);
+	}
+
+	__forceinline bool TryPop(T& Dest) noexcept
+	{
+		const size_t nHead = m_nHead.load(std::memory_order_relaxed);
+		if (!HasItems(nHead, 1))
+			return false;
+
+		T* pSlot = Slot(nHead);
+		Dest = std::move(*pSlot);
+		pSlot->~T();
+
+		m_nHead.store(nHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	__forceinline void Pop(T& Dest) noexcept
+	{
+		int nSpins = 0;
+		while (!TryPop(Dest))
+			FTQueueBackoff(m_Wait, nSpins);
+	}
+
+	// Pushes as many of pSrc as currently fit (at most two contiguous copies), returns how many
+	__forceinline int PushN(const T* pSrc, const int nCount) noexcept
+	{
+		const size_t nTail = m_nTail.load(std::memory_order_relaxed);
+
+		int nNum = m_nCapacity - static_cast<int>(nTail - m_nCachedHead);
+		if (nNum < nCount)
+		{
+			m_nCachedHead = m_nHead.load(std::memory_order_acquire);
+			nNum = m_nCapacity - static_cast<int>(nTail - m_nCachedHead);
+		}
+
+		if (nNum > nCount)
+			nNum = nCount;
+
+		if (nNum <= 0)
+			return 0;
+
+		const int nFirst = Contiguous(nTail, nNum);
+		CopyIn(Slot(nTail), pSrc, nFirst);
+		CopyIn(Slot(nTail + nFirst), pSrc + nFirst, nNum - nFirst);
+
+		m_nTail.store(nTail + nNum, std::memory_order_release);
+		return nNum;
+	}
+
+	// Waits until all of pSrc has been pushed
+	__forceinline void PushAll(const T* pSrc, int nCount) noexcept
+	{
+		int nSpins = 0;
+		while (nCount > 0)
+		{
+			const int nPushed = PushN(pSrc, nCount);
+			if (!nPushed)
+			{
+				FTQueueBackoff(m_Wait, nSpins);
+				continue;
+			}
+
+			pSrc += nPushed;
+			nCount -= nPushed;
+			nSpins = 0;
+		}
+	}
+
+	// Pops up to nMaxCount items into pDest (at most two contiguous copies), returns how many
+	__forceinline int PopN(T* pDest, const int nMaxCount) noexcept
+	{
+		const size_t nHead = m_nHead.load(std::memory_order_relaxed);
+
+		int nNum = static_cast<int>(m_nCachedTail - nHead);
+		if (nNum < nMaxCount)
+		{
+			m_nCachedTail = m_nTail.load(std::memory_order_acquire);
+			nNum = static_cast<int>(m_nCachedTail - nHead);
+		}
+
+		if (nNum > nMaxCount)
+			nNum = nMaxCount;
+
+		if (nNum <= 0)
+			return 0;
+
+		const int nFirst = Contiguous(nHead, nNum);
+		MoveOut(pDest, Slot(nHead), nFirst);
+		MoveOut(pDest + nFirst, Slot(nHead + nFirst), nNum - nFirst);
+
+		m_nHead.store(nHead + nNum, std::memory_order_release);
+		return nNum;
+	}
+
+private:
+	__forceinline T* Slot(const size_t nIndex) noexcept
+	{
+		return m_Memory.Base() + (nIndex & static_cast<size_t>(m_nCapacity - 1));
+	}
+
+	// Number of items starting at nIndex that fit before the ring wraps
+	__forceinline int Contiguous(const size_t nIndex, const int nNum) const noexcept
+	{
+		const int nUntilEnd = m_nCapacity - static_cast<int>(nIndex & static_cast<size_t>(m_nCapacity - 1));
+		return (nNum < nUntilEnd) ? nNum : nUntilEnd;
+	}
+
+	// Producer side, only reloads the consumer's index when the cached one says we're full
+	__forceinline bool HasRoom(const size_t nTail, const int nNum) noexcept
+	{
+		if (nTail - m_nCachedHead + nNum <= static_cast<size_t>(m_nCapacity))
+			return true;
+
+		m_nCachedHead = m_nHead.load(std::memory_order_acquire);
+		return nTail - m_nCachedHead + nNum <= static_cast<size_t>(m_nCapacity);
+	}
+
+	// Consumer side, only reloads the producer's index when the cached one says we're empty
+	__forceinline bool HasItems(const size_t nHead, const int nNum) noexcept
+	{
+		if (m_nCachedTail - nHead >= static_cast<size_t>(nNum))
+			return true;
+
+		m_nCachedTail = m_nTail.load(std::memory_order_acquire);
+		return m_nCachedTail - nHead >= static_cast<size_t>(nNum);
+	}
+
+	static __forceinline void CopyIn(T* pDest, const T* pSrc, const int nNum) noexcept
+	{
+		if (std::is_trivially_copyable<T>::value)
+			memcpy(static_cast<void*>(pDest), pSrc, static_cast<size_t>(nNum) * sizeof(T));
+		else
+		{
+			for (int i = 0; i < nNum; i++)
+				::new(pDest + i) T(pSrc[i]);
+		}
+	}
+
+	static __forceinline void MoveOut(T* pDest, T* pSrc, const int nNum) noexcept
+	{
+		if (std::is_trivially_copyable<T>::value)
+			memcpy(static_cast<void*>(pDest), pSrc, static_cast<size_t>(nNum) * sizeof(T));
+		else
+		{
+			for (int i = 0; i < nNum; i++)
+			{
+				pDest[i] = std::move(pSrc[i]);
+				pSrc[i].~T();
+			}
+		}
+	}
+
+	// Consumer
+	alignas(FT_CACHE_LINE_SIZE) std::atomic<size_t> m_nHead{ 0 };
+	size_t m_nCachedTail = 0;
+
+	// Producer
+	alignas(FT_CACHE_LINE_SIZE) std::atomic<size_t> m_nTail{ 0 };
+	size_t m_nCachedHead = 0;
+
+	// Read only after construction
+	alignas(FT_CACHE_LINE_SIZE) FTMemory<T> m_Memory;
+	int m_nCapacity;
+	FTQueueWait m_Wait;
+};
+
+/*
+ * Bounded lock-free queue for any number of producers and consumers
+ * Every slot carries a sequence number that tells whether it's ready to be written or read
+ * for the current lap, so producers and consumers only contend on their own index
+ */
+template<typename T>
+class FTMpmcQueue
+{
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		alignas(T) unsigned char Storage[sizeof(T)];
+	};
+
+public:
+	__forceinline explicit FTMpmcQueue(const int nCapacity, const FTQueueWait Wait = FTQueueWait::Spin) noexcept
+		: m_Memory(0, FTQueueCapacity(nCapacity)), m_nCapacity(FTQueueCapacity(nCapacity)), m_Wait(Wait)
+	{
+		for (int i = 0; i < m_nCapacity; i++)
+			::new(&m_Memory[i].Sequence) std::atomic<size_t>(static_cast<size_t>(i));
+	}
+
+	FTMpmcQueue(const FTMpmcQueue<T>&) = delete;
+	FTMpmcQueue<T>& operator=(const FTMpmcQueue<T>&) = delete;
+
+	__forceinline ~FTMpmcQueue() noexcept
+	{
+		// No other thread can be using the queue anymore, so every slot in [head, tail) holds an item
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			const size_t nTail = m_nTail.load(std::memory_order_relaxed);
+			for (size_t i = m_nHead.load(std::memory_order_relaxed); i != nTail; i++)
+				reinterpret_cast<T*>(m_Memory[static_cast<int>(i & static_cast<size_t>(m_nCapacity - 1))].Storage)->~T();
+		}
+
+		m_Memory.Purge();
+	}
+
+	__forceinline int GetCapacity() const noexcept
+	{
+		return m_nCapacity;
+	}
+
+	template<typename U>
+	__forceinline bool TryPush(U&& Src) noexcept
+	{
+		size_t nPosition = m_nTail.load(std::memory_order_relaxed);
+
+		Cell* pCell;
+		for (;;)
+		{
+			pCell = &m_Memory[static_cast<int>(nPosition & static_cast<size_t>(m_nCapacity - 1))];
+
+			const size_t nSequence = pCell->Sequence.load(std::memory_order_acquire);
+			const ptrdiff_t nDiff = static_cast<ptrdiff_t>(nSequence) - static_cast<ptrdiff_t>(nPosition);
+
+			if (nDiff == 0)
+			{
+				if (m_nTail.compare_exchange_weak(nPosition, nPosition + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (nDiff < 0)
+				return false; // Full, the slot still holds last lap's item
+			else
+				nPosition = m_nTail.load(std::memory_order_relaxed);
+		}
+
+		::new(pCell->Storage) T(std::forward<U>(Src));
+		pCell->Sequence.store(nPosition + 1, std::memory_order_release);
+		return true;
+	}
+
+	__forceinline void Push(const T& Src) noexcept
+	{
+		int nSpins = 0;
+		while (!TryPush(Src))
+			FTQueueBackoff(m_Wait, nSpins);
+	}
+
+	__forceinline bool TryPop(T& Dest) noexcept
+	{
+		size_t nPosition = m_nHead.load(std::memory_order_relaxed);
+
+		Cell* pCell;
+		for (;;)
+		{
+			pCell = &m_Memory[static_cast<int>(nPosition & static_cast<size_t>(m_nCapacity - 1))];
+
+			const size_t nSequence = pCell->Sequence.load(std::memory_order_acquire);
+			const ptrdiff_t nDiff = static_cast<ptrdiff_t>(nSequence) - static_cast<ptrdiff_t>(nPosition + 1);
+
+			if (nDiff == 0)
+			{
+				if (m_nHead.compare_exchange_weak(nPosition, nPosition + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (nDiff < 0)
+				return false; // Empty, nothing has been written to this slot for this lap
+			else
+				nPosition = m_nHead.load(std::memory_order_relaxed);
+		}
+
+		T* pItem = reinterpret_cast<T*>(pCell->Storage);
+		Dest = std::move(*pItem);
+		pItem->~T();
+
+		pCell->Sequence.store(nPosition + static_cast<size_t>(m_nCapacity), std::memory_order_release);
+		return true;
+	}
+
+	__forceinline void Pop(T& Dest) noexcept
+	{
+		int nSpins = 0;
+		while (!TryPop(Dest))
+			FTQueueBackoff(m_Wait, nSpins);
+	}
+
+	// Slots can't be claimed as a run without serializing producers, so these push/pop one by one
+	__forceinline int PushN(const T* pSrc, const int nCount) noexcept
+	{
+		int nNum = 0;
+		while (nNum < nCount && TryPush(pSrc[nNum]))
+			nNum++;
+
+		return nNum;
+	}
+
+	__forceinline int PopN(T* pDest, const int nMaxCount) noexcept
+	{
+		int nNum = 0;
+		while (nNum < nMaxCount && TryPop(pDest[nNum]))
+			nNum++;
+
+		return nNum;
+	}
+
+private:
+	alignas(FT_CACHE_LINE_SIZE) std::atomic<size_t> m_nHead{ 0 };
+	alignas(FT_CACHE_LINE_SIZE) std::atomic<size_t> m_nTail{ 0 };
+
+	// Read only after construction
+	alignas(FT_CACHE_LINE_SIZE) FTMemory<Cell> m_Memory;
+	int m_nCapacity;
+	FTQueueWait m_Wait;
+};
@@ -0,0 +1,598 @@
+#pragma once
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <type_traits>
+
+#include "Cpu.h"
+#include "Globals.h"
+
+// Below this many elements the threaded versions just run on the calling thread
+constexpr int FT_PARALLEL_REDUCE_THRESHOLD = 1 << 16;
+
+/*
+ * Splits [0, nCount) into nNumThreads contiguous chunks, one thread each, the last one takes the remainder
+ * More threads than cores is allowed, they just get time sliced
+ */
+template<typename Func>
+__forceinline void FTForEachChunk(const int nCount, const int nNumThreads, Func Fn)
+{
+	FT_ASSERT(nNumThreads > 0);
+
+	const int nChunkSize = nCount / nNumThreads;
+
+	std::vector<std::thread> Threads;
+	Threads.reserve(static_cast<size_t>(nNumThreads));
+
+	for (int i = 0; i < nNumThreads; i++)
+	{
+		const int nFirst = i * nChunkSize;
+		const int nNum = (i == nNumThreads - 1) ? nCount - nFirst : nChunkSize;
+
+		Threads.emplace_back([&Fn, i, nFirst, nNum]() { Fn(i, nFirst, nNum); });
+	}
+
+	for (std::thread& Thread : Threads)
+		Thread.join();
+}
+
+/*
+ * Hand vectorized kernels for the common element types
+ * Every loop keeps several independent accumulators so it isn't bound by the latency
+ * of a single add/min chain, NaNs are not treated specially
+ */
+class FTSimd
+{
+public:
+	static float SumSse(const float* pData, const int nCount) noexcept
+	{
+		__m128 Acc0 = _mm_setzero_ps(), Acc1 = _mm_setzero_ps(), Acc2 = _mm_setzero_ps(), Acc3 = _mm_setzero_ps();
+
+		int i = 0;
+		for (; i + 16 <= nCount; i += 16)
+		{
+			Acc0 = _mm_add_ps(Acc0, _mm_loadu_ps(pData + i));
+			Acc1 = _mm_add_ps(Acc1, _mm_loadu_ps(pData + i + 4));
+			Acc2 = _mm_add_ps(Acc2, _mm_loadu_ps(pData + i + 8));
+			Acc3 = _mm_add_ps(Acc3, _mm_loadu_ps(pData + i + 12));
+		}
+
+		float Result = HorizontalAdd(_mm_add_ps(_mm_add_ps(Acc0, Acc1), _mm_add_ps(Acc2, Acc3)));
+		for (; i < nCount; i++)
+			Result += pData[i];
+
+		return Result;
+	}
+
+	FT_TARGET_AVX2 static float SumAvx2(const float* pData, const int nCount) noexcept
+	{
+		__m256 Acc0 = _mm256_setzero_ps(), Acc1 = _mm256_setzero_ps();
+		__m256 Acc2 = _mm256_setzero_ps(), Acc3 = _mm256_setzero_ps();
+
+		int i = 0;
+		for (; i + 32 <= nCount; i += 32)
+		{
+			Acc0 = _mm256_add_ps(Acc0, _mm256_loadu_ps(pData + i));
+			Acc1 = _mm256_add_ps(Acc1, _mm256_loadu_ps(pData + i + 8));
+			Acc2 = _mm256_add_ps(Acc2, _mm256_loadu_ps(pData + i + 16));
+			Acc3 = _mm256_add_ps(Acc3, _mm256_loadu_ps(pData + i + 24));
+		}
+
+		const __m256 Acc = _mm256_add_ps(_mm256_add_ps(Acc0, Acc1), _mm256_add_ps(Acc2, Acc3));
+		float Result = HorizontalAdd(_mm_add_ps(_mm256_castps256_ps128(Acc), _mm256_extractf128_ps(Acc, 1)));
+		for (; i < nCount; i++)
+			Result += pData[i];
+
+		return Result;
+	}
+
+	static double SumSse(const double* pData, const int nCount) noexcept
+	{
+		__m128d Acc0 = _mm_setzero_pd(), Acc1 = _mm_setzero_pd(), Acc2 = _mm_setzero_pd(), Acc3 = _mm_setzero_pd();
+
+		int i = 0;
+		for (; i + 8 <= nCount; i += 8)
+		{
+			Acc0 = _mm_add_pd(Acc0, _mm_loadu_pd(pData + i));
+			Acc1 = _mm_add_pd(Acc1, _mm_loadu_pd(pData + i + 2));
+			Acc2 = _mm_add_pd(Acc2, _mm_loadu_pd(pData + i + 4));
+			Acc3 = _mm_add_pd(Acc3, _mm_loadu_pd(pData + i + 6));
+		}
+
+		double Result = HorizontalAdd(_mm_add_pd(_mm_add_pd(Acc0, Acc1), _mm_add_pd(Acc2, Acc3)));
+		for (; i < nCount; i++)
+			Result += pData[i];
+
+		return Result;
+	}
+
+	FT_TARGET_AVX2 static double SumAvx2(const double* pData, const int nCount) noexcept
+	{
+		__m256d Acc0 = _mm256_setzero_pd(), Acc1 = _mm256_setzero_pd();
+		__m256d Acc2 = _mm256_setzero_pd(), Acc3 = _mm256_setzero_pd();
+
+		int i = 0;
+		for (; i + 16 <= nCount; i += 16)
+		{
+			Acc0 = _mm256_add_pd(Acc0, _mm256_loadu_pd(pData + i));
+			Acc1 = _mm256_add_pd(Acc1, _mm256_loadu_pd(pData + i + 4));
+			Acc2 = _mm256_add_pd(Acc2, _mm256_loadu_pd(pData + i + 8));
+			Acc3 = _mm256_add_pd(Acc3, _mm256_loadu_pd(pData + i + 12));
+		}
+
+		const __m256d Acc = _mm256_add_pd(_mm256_add_pd(Acc0, Acc1), _mm256_add_pd(Acc2, Acc3));
+		double Result = HorizontalAdd(_mm_add_pd(_mm256_castpd256_pd128(Acc), _mm256_extractf128_pd(Acc, 1)));
+		for (; i < nCount; i++)
+			Result += pData[i];
+
+		return Result;
+	}
+
+	// 32-bit ints are widened to 64-bit lanes so large arrays don't overflow
+	FT_TARGET_AVX2 static long long SumAvx2(const int* pData, const int nCount) noexcept
+	{
+		__m256i Acc0 = _mm256_setzero_si256(), Acc1 = _mm256_setzero_si256();
+		__m256i Acc2 = _mm256_setzero_si256(), Acc3 = _mm256_setzero_si256();
+
+		int i = 0;
+		for (; i + 16 <= nCount; i += 16)
+		{
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + i));
+			const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + i + 8));
+
+			Acc0 = _mm256_add_epi64(Acc0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(a)));
+			Acc1 = _mm256_add_epi64(Acc1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(a, 1)));
+			Acc2 = _mm256_add_epi64(Acc2, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(b)));
+			Acc3 = _mm256_add_epi64(Acc3, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(b, 1)));
+		}
+
+		alignas(32) long long Lanes[4];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(Lanes),
+			_mm256_add_epi64(_mm256_add_epi64(Acc0, Acc1), _mm256_add_epi64(Acc2, Acc3)));
+
+		long long Result = (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+		for (; i < nCount; i++)
+			Result += pData[i];
+
+		return Result;
+	}
+
+	static void MinMaxSse(const float* pData, const int nCount, float& Min, float& Max) noexcept
+	{
+		__m128 Min0 = _mm_set1_ps(pData[0]), Min1 = Min0, Max0 = Min0, Max1 = Min0;
+
+		int i = 0;
+		for (; i + 8 <= nCount; i += 8)
+		{
+			const __m128 a = _mm_loadu_ps(pData + i);
+			const __m128 b = _mm_loadu_ps(pData + i + 4);
+
+			Min0 = _mm_min_ps(Min0, a);
+			Max0 = _mm_max_ps(Max0, a);
+			Min1 = _mm_min_ps(Min1, b);
+			Max1 = _mm_max_ps(Max1, b);
+		}
+
+		alignas(16) float MinLanes[4], MaxLanes[4];
+		_mm_store_ps(MinLanes, _mm_min_ps(Min0, Min1));
+		_mm_store_ps(MaxLanes, _mm_max_ps(Max0, Max1));
+
+		FinishMinMax(MinLanes, MaxLanes, 4, pData + i, nCount - i, Min, Max);
+	}
+
+	FT_TARGET_AVX2 static void MinMaxAvx2(const float* pData, const int nCount, float& Min, float& Max) noexcept
+	{
+		__m256 Min0 = _mm256_set1_ps(pData[0]), Min1 = Min0, Max0 = Min0, Max1 = Min0;
+
+		int i = 0;
+		for (; i + 16 <= nCount; i += 16)
+		{
+			const __m256 a = _mm256_loadu_ps(pData + i);
+			const __m256 b = _mm256_loadu_ps(pData + i + 8);
+
+			Min0 = _mm256_min_ps(Min0, a);
+			Max0 = _mm256_max_ps(Max0, a);
+			Min1 = _mm256_min_ps(Min1, b);
+			Max1 = _mm256_max_ps(Max1, b);
+		}
+
+		alignas(32) float MinLanes[8], MaxLanes[8];
+		_mm256_store_ps(MinLanes, _mm256_min_ps(Min0, Min1));
+		_mm256_store_ps(MaxLanes, _mm256_max_ps(Max0, Max1));
+
+		FinishMinMax(MinLanes, MaxLanes, 8, pData + i, nCount - i, Min, Max);
+	}
+
+	static void MinMaxSse(const double* pData, const int nCount, double& Min, double& Max) noexcept
+	{
+		__m128d Min0 = _mm_set1_pd(pData[0]), Min1 = Min0, Max0 = Min0, Max1 = Min0;
+
+		int i = 0;
+		for (; i + 4 <= nCount; i += 4)
+		{
+			const __m128d a = _mm_loadu_pd(pData + i);
+			const __m128d b = _mm_loadu_pd(pData + i + 2);
+
+			Min0 = _mm_min_pd(Min0, a);
+			Max0 = _mm_max_pd(Max0, a);
+			Min1 = _mm_min_pd(Min1, b);
+			Max1 = _mm_max_pd(Max1, b);
+		}
+
+		alignas(16) double MinLanes[2], MaxLanes[2];
+		_mm_store_pd(MinLanes, _mm_min_pd(Min0, Min1));
+		_mm_store_pd(MaxLanes, _mm_max_pd(Max0, Max1));
+
+		FinishMinMax(MinLanes, MaxLanes, 2, pData + i, nCount - i, Min, Max);
+	}
+
+	FT_TARGET_AVX2 static void MinMaxAvx2(const double* pData, const int nCount, double& Min, double& Max) noexcept
+	{
+		__m256d Min0 = _mm256_set1_pd(pData[0]), Min1 = Min0, Max0 = Min0, Max1 = Min0;
+
+		int i = 0;
+		for (; i + 8 <= nCount; i += 8)
+		{
+			const __m256d a = _mm256_loadu_pd(pData + i);
+			const __m256d b = _mm256_loadu_pd(pData + i + 4);
+
+			Min0 = _mm256_min_pd(Min0, a);
+			Max0 = _mm256_max_pd(Max0, a);
+			Min1 = _mm256_min_pd(Min1, b);
+			Max1 = _mm256_max_pd(Max1, b);
+		}
+
+		alignas(32) double MinLanes[4], MaxLanes[4];
+		_mm256_store_pd(MinLanes, _mm256_min_pd(Min0, Min1));
+		_mm256_store_pd(MaxLanes, _mm256_max_pd(Max0, Max1));
+
+		FinishMinMax(MinLanes, MaxLanes, 4, pData + i, nCount - i, Min, Max);
+	}
+
+	FT_TARGET_AVX2 static void MinMaxAvx2(const int* pData, const int nCount, int& Min, int& Max) noexcept
+	{
+		__m256i Min0 = _mm256_set1_epi32(pData[0]), Min1 = Min0, Max0 = Min0, Max1 = Min0;
+
+		int i = 0;
+		for (; i + 16 <= nCount; i += 16)
+		{
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + i));
+			const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + i + 8));
+
+			Min0 = _mm256_min_epi32(Min0, a);
+			Max0 = _mm256_max_epi32(Max0, a);
+			Min1 = _mm256_min_epi32(Min1, b);
+			Max1 = _mm256_max_epi32(Max1, b);
+		}
+
+		alignas(32) int MinLanes[8], MaxLanes[8];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(MinLanes), _mm256_min_epi32(Min0, Min1));
+		_mm256_store_si256(reinterpret_cast<__m256i*>(MaxLanes), _mm256_max_epi32(Max0, Max1));
+
+		FinishMinMax(MinLanes, MaxLanes, 8, pData + i, nCount - i, Min, Max);
+	}
+
+private:
+	static __forceinline float HorizontalAdd(const __m128 v) noexcept
+	{
+		const __m128 Shuffled = _mm_movehl_ps(v, v);
+		const __m128 Sums = _mm_add_ps(v, Shuffled);
+		return _mm_cvtss_f32(_mm_add_ss(Sums, _mm_shuffle_ps(Sums, Sums, 1)));
+	}
+
+	static __forceinline double HorizontalAdd(const __m128d v) noexcept
+	{
+		return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+	}
+
+	// Folds the vector lanes and the scalar tail into the final result
+	template<typename T>
+	static __forceinline void FinishMinMax(const T* pMinLanes, const T* pMaxLanes, const int nLanes,
+		const T* pTail, const int nTail, T& Min, T& Max) noexcept
+	{
+		Min = pMinLanes[0];
+		Max = pMaxLanes[0];
+
+		for (int i = 1; i < nLanes; i++)
+		{
+			if (pMinLanes[i] < Min)
+				Min = pMinLanes[i];
+			if (pMaxLanes[i] > Max)
+				Max = pMaxLanes[i];
+		}
+
+		for (int i = 0; i < nTail; i++)
+		{
+			if (pTail[i] < Min)
+				Min = pTail[i];
+			if (pTail[i] > Max)
+				Max = pTail[i];
+		}
+	}
+};
+
+/*
+ * Aggregates over raw arithmetic data, FTArray forwards to these
+ * float/double/int pick an SSE or AVX2 kernel at runtime, every other type uses the
+ * unrolled scalar loops which the compiler is free to vectorize on its own
+ */
+template<typename T>
+class FTReduce
+{
+	static_assert(std::is_arithmetic<T>::value, "FTReduce is only for numbers");
+
+public:
+	// Integers are summed in 64 bits so a few million values can't overflow the result
+	using SumType = std::conditional_t<std::is_floating_point<T>::value, T,
+		std::conditional_t<std::is_signed<T>::value, long long, unsigned long long>>;
+
+	static __forceinline SumType Sum(const T* pData, const int nCount) noexcept
+	{
+		FT_ASSERT(nCount >= 0);
+
+		if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value)
+			return FTCpu::HasAvx2() ? FTSimd::SumAvx2(pData, nCount) : FTSimd::SumSse(pData, nCount);
+		else if constexpr (std::is_same<T, int>::value)
+		{
+			if (FTCpu::HasAvx2())
+				return FTSimd::SumAvx2(pData, nCount);
+		}
+
+		SumType Acc0 = 0, Acc1 = 0, Acc2 = 0, Acc3 = 0;
+
+		int i = 0;
+		for (; i + 4 <= nCount; i += 4)
+		{
+			Acc0 += pData[i];
+			Acc1 += pData[i + 1];
+			Acc2 += pData[i + 2];
+			Acc3 += pData[i + 3];
+		}
+
+		for (; i < nCount; i++)
+			Acc0 += pData[i];
+
+		return (Acc0 + Acc1) + (Acc2 + Acc3);
+	}
+
+	// Neumaier's variant of Kahan summation, slower but the error doesn't grow with nCount
+	static __forceinline SumType SumCompensated(const T* pData, const int nCount) noexcept
+	{
+		if constexpr (!std::is_floating_point<T>::value)
+			return Sum(pData, nCount);
+		else
+		{
+			T Result = 0;
+			T Compensation = 0;
+
+			for (int i = 0; i < nCount; i++)
+			{
+				const T Value = pData[i];
+				const T Temp = Result + Value;
+
+				if (std::abs(Result) >= std::abs(Value))
+					Compensation += (Result - Temp) + Value;
+				else
+					Compensation += (Value - Temp) + Result;
+
+				Result = Temp;
+			}
+
+			return Result + Compensation;
+		}
+	}
+
+	static __forceinline SumType Sum(const T* pData, const int nCount, const int nNumThreads) noexcept
+	{
+		if (nNumThreads <= 1 || nCount < FT_PARALLEL_REDUCE_THRESHOLD)
+			return Sum(pData, nCount);
+
+		std::vector<SumType> Partials(static_cast<size_t>(nNumThreads));
+		FTForEachChunk(nCount, nNumThreads, [&](const int nThread, const int nFirst, const int nNum)
+			{
+				Partials[nThread] = Sum(pData + nFirst, nNum);
+			});
+
+		SumType Result = 0;
+		for (const SumType Partial : Partials)
+			Result += Partial;
+
+		return Result;
+	}
+
+	// An empty range has no minimum or maximum, both are set to T() so callers never read pData
+	static __forceinline void MinMax(const T* pData, const int nCount, T& Min, T& Max) noexcept
+	{
+		if (nCount <= 0)
+		{
+			Min = T();
+			Max = T();
+			return;
+		}
+
+		if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value)
+		{
+			if (FTCpu::HasAvx2())
+				FTSimd::MinMaxAvx2(pData, nCount, Min, Max);
+			else
+				FTSimd::MinMaxSse(pData, nCount, Min, Max);
+			return;
+		}
+		else if constexpr (std::is_same<T, int>::value)
+		{
+			if (FTCpu::HasAvx2())
+			{
+				FTSimd::MinMaxAvx2(pData, nCount, Min, Max);
+				return;
+			}
+		}
+
+		T Min0 = pData[0], Min1 = pData[0], Max0 = pData[0], Max1 = pData[0];
+
+		int i = 0;
+		for (; i + 2 <= nCount; i += 2)
+		{
+			Min0 = (pData[i] < Min0) ? pData[i] : Min0;
+			Max0 = (pData[i] > Max0) ? pData[i] : Max0;
+			Min1 = (pData[i + 1] < Min1) ? pData[i + 1] : Min1;
+			Max1 = (pData[i + 1] > Max1) ? pData[i + 1] : Max1;
+		}
+
+		for (; i < nCount; i++)
+		{
+			Min0 = (pData[i] < Min0) ? pData[i] : Min0;
+			Max0 = (pData[i] > Max0) ? pData[i] : Max0;
+		}
+
+		Min = (Min1 < Min0) ? Min1 : Min0;
+		Max = (Max1 > Max0) ? Max1 : Max0;
+	}
+
+	static __forceinline T Min(const T* pData, const int nCount) noexcept
+	{
+		T MinValue, MaxValue;
+		MinMax(pData, nCount, MinValue, MaxValue);
+		return MinValue;
+	}
+
+	static __forceinline T Max(const T* pData, const int nCount) noexcept
+	{
+		T MinValue, MaxValue;
+		MinMax(pData, nCount, MinValue, MaxValue);
+		return MaxValue;
+	}
+
+	/*
+	 * Finding the value with the vector kernel and then its first position is two streaming
+	 * passes, that's still faster than a scalar loop carrying an index next to the value
+	 * A NaN can come out of the vector kernel and then match nothing, in that case a scalar
+	 * scan that skips NaNs picks the index, so non-empty input always gives a valid index
+	 */
+	static __forceinline int ArgMin(const T* pData, const int nCount) noexcept
+	{
+		if (nCount <= 0)
+			return FT_INVALID_INDEX;
+
+		const int nIndex = IndexOf(pData, nCount, Min(pData, nCount));
+		if (nIndex != FT_INVALID_INDEX)
+			return nIndex;
+
+		return IndexOfBest(pData, nCount, [](const T a, const T b) { return a < b; });
+	}
+
+	static __forceinline int ArgMax(const T* pData, const int nCount) noexcept
+	{
+		if (nCount <= 0)
+			return FT_INVALID_INDEX;
+
+		const int nIndex = IndexOf(pData, nCount, Max(pData, nCount));
+		if (nIndex != FT_INVALID_INDEX)
+			return nIndex;
+
+		return IndexOfBest(pData, nCount, [](const T a, const T b) { return a > b; });
+	}
+
+	// pSrc and pDst may be the same buffer
+	static __forceinline void InclusiveScan(const T* pSrc, T* pDst, const int nCount) noexcept
+	{
+		InclusiveScanFrom(pSrc, pDst, nCount, T());
+	}
+
+	static __forceinline void ExclusiveScan(const T* pSrc, T* pDst, const int nCount, const T Init = T()) noexcept
+	{
+		T Running = Init;
+		for (int i = 0; i < nCount; i++)
+		{
+			const T Value = pSrc[i];
+			pDst[i] = Running;
+			Running += Value;
+		}
+	}
+
+	/*
+	 * Two pass parallel scan
+	 * Pass 1 sums every chunk, the chunk totals are scanned on the calling thread and
+	 * pass 2 scans every chunk again starting from its offset
+	 */
+	static __forceinline void InclusiveScan(const T* pSrc, T* pDst, const int nCount, const int nNumThreads) noexcept
+	{
+		if (nNumThreads <= 1 || nCount < FT_PARALLEL_REDUCE_THRESHOLD)
+		{
+			InclusiveScan(pSrc, pDst, nCount);
+			return;
+		}
+
+		std::vector<T> Offsets(static_cast<size_t>(nNumThreads));
+		FTForEachChunk(nCount, nNumThreads, [&](const int nThread, const int nFirst, const int nNum)
+			{
+				Offsets[nThread] = static_cast<T>(Sum(pSrc + nFirst, nNum));
+			});
+
+		ExclusiveScan(Offsets.data(), Offsets.data(), nNumThreads);
+
+		FTForEachChunk(nCount, nNumThreads, [&](const int nThread, const int nFirst, const int nNum)
+			{
+				InclusiveScanFrom(pSrc + nFirst, pDst + nFirst, nNum, Offsets[nThread]);
+			});
+	}
+
+	// Same two passes, every chunk's offset already includes Init
+	static __forceinline void ExclusiveScan(const T* pSrc, T* pDst, const int nCount, const T Init,
+		const int nNumThreads) noexcept
+	{
+		if (nNumThreads <= 1 || nCount < FT_PARALLEL_REDUCE_THRESHOLD)
+		{
+			ExclusiveScan(pSrc, pDst, nCount, Init);
+			return;
+		}
+
+		std::vector<T> Offsets(static_cast<size_t>(nNumThreads));
+		FTForEachChunk(nCount, nNumThreads, [&](const int nThread, const int nFirst, const int nNum)
+			{
+				Offsets[nThread] = static_cast<T>(Sum(pSrc + nFirst, nNum));
+			});
+
+		ExclusiveScan(Offsets.data(), Offsets.data(), nNumThreads, Init);
+
+		FTForEachChunk(nCount, nNumThreads, [&](const int nThread, const int nFirst, const int nNum)
+			{
+				ExclusiveScan(pSrc + nFirst, pDst + nFirst, nNum, Offsets[nThread]);
+			});
+	}
+
+private:
+	static __forceinline void InclusiveScanFrom(const T* pSrc, T* pDst, const int nCount, const T Offset) noexcept
+	{
+		T Running = Offset;
+		for (int i = 0; i < nCount; i++)
+		{
+			Running += pSrc[i];
+			pDst[i] = Running;
+		}
+	}
+
+	static __forceinline int IndexOf(const T* pData, const int nCount, const T Value) noexcept
+	{
+		for (int i = 0; i < nCount; i++)
+		{
+			if (pData[i] == Value)
+				return i;
+		}
+
+		return FT_INVALID_INDEX;
+	}
+
+	// First index of the best value, a NaN never compares better and is replaced by anything after it
+	template<typename Compare>
+	static __forceinline int IndexOfBest(const T* pData, const int nCount, Compare Comp) noexcept
+	{
+		int nBest = 0;
+		for (int i = 1; i < nCount; i++)
+		{
+			if (Comp(pData[i], pData[nBest]) || pData[nBest] != pData[nBest])
+				nBest = i;
+		}
+
+		return nBest;
+	}
+};
@@ -0,0 +1,305 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#include "Reduce.h"
+#include "Globals.h"
+
+// Ranges this small are finished with an insertion sort
+constexpr int FT_SELECT_INSERTION_THRESHOLD = 16;
+
+// TopK keeps a k sized heap while streaming when k is at most 1/16th of the input
+constexpr int FT_TOPK_HEAP_RATIO = 16;
+
+// Below this many elements the threaded TopK just runs on the calling thread
+constexpr int FT_PARALLEL_SELECT_THRESHOLD = 1 << 16;
+
+/*
+ * Selection kernels over raw data, FTArray forwards to these
+ * Compare follows the std convention, Compare(a, b) is true when a goes before b. For the
+ * TopK functions "before" means better, so the default std::greater<T> gives the largest values
+ */
+template<typename T>
+class FTSelect
+{
+public:
+	/*
+	 * Introselect: quickselect with a median of three pivot and a three way partition, so runs of
+	 * equal values don't degrade it. If it recurses deeper than 2 * log2(n) it falls back to a heap
+	 * based selection, which keeps the worst case at O(n log n) while the average stays O(n)
+	 */
+	template<typename Compare = std::less<T>>
+	static __forceinline void NthElement(T* pData, const int nCount, const int nNth, Compare Comp = Compare())
+	{
+		FT_ASSERT(nNth >= 0 && nNth < nCount);
+
+		int nLow = 0;
+		int nHigh = nCount;
+		int nDepthLimit = 2 * Log2(nCount);
+
+		while (nHigh - nLow > FT_SELECT_INSERTION_THRESHOLD)
+		{
+			if (nDepthLimit-- == 0)
+			{
+				std::partial_sort(pData + nLow, pData + nNth + 1, pData + nHigh, Comp);
+				return;
+			}
+
+			int nLess, nGreater;
+			Partition(pData, nLow, nHigh, nLess, nGreater, Comp);
+
+			if (nNth < nLess)
+				nHigh = nLess;
+			else if (nNth >= nGreater)
+				nLow = nGreater;
+			else
+				return; // nNth landed among the values equal to the pivot
+		}
+
+		InsertionSort(pData + nLow, nHigh - nLow, Comp);
+	}
+
+	// The first nK elements end up sorted, the rest in unspecified order
+	template<typename Compare = std::less<T>>
+	static __forceinline void PartialSort(T* pData, const int nCount, int nK, Compare Comp = Compare())
+	{
+		if (nK > nCount)
+			nK = nCount;
+
+		if (nK <= 0)
+			return;
+
+		if (nK == nCount)
+		{
+			std::sort(pData, pData + nCount, Comp);
+			return;
+		}
+
+		// Everything before nK - 1 is already no worse than it, only that prefix needs sorting
+		NthElement(pData, nCount, nK - 1, Comp);
+		std::sort(pData, pData + nK - 1, Comp);
+	}
+
+	// Writes the nK best values to pOut, best first, returns how many were written
+	template<typename Compare = std::greater<T>>
+	static __forceinline int TopK(const T* pData, const int nCount, int nK, T* pOut, Compare Comp = Compare())
+	{
+		if (nK > nCount)
+			nK = nCount;
+
+		if (nK <= 0)
+			return 0;
+
+		if (nK * FT_TOPK_HEAP_RATIO <= nCount)
+		{
+			// The heap holds the best nK seen so far with the worst of them on top
+			for (int i = 0; i < nK; i++)
+				pOut[i] = pData[i];
+
+			std::make_heap(pOut, pOut + nK, Comp);
+
+			for (int i = nK; i < nCount; i++)
+			{
+				if (!Comp(pData[i], pOut[0]))
+					continue;
+
+				std::pop_heap(pOut, pOut + nK, Comp);
+				pOut[nK - 1] = pData[i];
+				std::push_heap(pOut, pOut + nK, Comp);
+			}
+
+			std::sort_heap(pOut, pOut + nK, Comp);
+			return nK;
+		}
+
+		std::vector<T> Scratch(pData, pData + nCount);
+		PartialSort(Scratch.data(), nCount, nK, Comp);
+
+		for (int i = 0; i < nK; i++)
+			pOut[i] = Scratch[i];
+
+		return nK;
+	}
+
+	// Same as TopK but writes the positions of the values, equal values are ordered by position
+	template<typename Compare = std::greater<T>>
+	static __forceinline int TopKIndices(const T* pData, const int nCount, int nK, int* pOut, Compare Comp = Compare())
+	{
+		auto IndexComp = [pData, &Comp](const int a, const int b)
+		{
+			return Comp(pData[a], pData[b]) || (!Comp(pData[b], pData[a]) && a < b);
+		};
+
+		if (nK > nCount)
+			nK = nCount;
+
+		if (nK <= 0)
+			return 0;
+
+		if (nK * FT_TOPK_HEAP_RATIO <= nCount)
+		{
+			for (int i = 0; i < nK; i++)
+				pOut[i] = i;
+
+			std::make_heap(pOut, pOut + nK, IndexComp);
+
+			for (int i = nK; i < nCount; i++)
+			{
+				if (!IndexComp(i, pOut[0]))
+					continue;
+
+				std::pop_heap(pOut, pOut + nK, IndexComp);
+				pOut[nK - 1] = i;
+				std::push_heap(pOut, pOut + nK, IndexComp);
+			}
+
+			std::sort_heap(pOut, pOut + nK, IndexComp);
+			return nK;
+		}
+
+		std::vector<int> Indices(static_cast<size_t>(nCount));
+		for (int i = 0; i < nCount; i++)
+			Indices[i] = i;
+
+		FTSelect<int>::PartialSort(Indices.data(), nCount, nK, IndexComp);
+
+		for (int i = 0; i < nK; i++)
+			pOut[i] = Indices[i];
+
+		return nK;
+	}
+
+	/*
+	 * Every thread finds the top nK of its own chunk, the at most nNumThreads * nK
+	 * candidates are then merged on the calling thread
+	 */
+	template<typename Compare = std::greater<T>>
+	static __forceinline int ParallelTopKIndices(const T* pData, const int nCount, int nK, int* pOut,
+		const int nNumThreads, Compare Comp = Compare())
+	{
+		if (nNumThreads <= 1 || nCount < FT_PARALLEL_SELECT_THRESHOLD)
+			return TopKIndices(pData, nCount, nK, pOut, Comp);
+
+		if (nK > nCount)
+			nK = nCount;
+
+		if (nK <= 0)
+			return 0;
+
+		std::vector<int> Candidates(static_cast<size_t>(nNumThreads) * static_cast<size_t>(nK));
+		std::vector<int> CandidateCounts(static_cast<size_t>(nNumThreads));
+
+		FTForEachChunk(nCount, nNumThreads, [&](const int nThread, const int nFirst, const int nNum)
+			{
+				int* pChunkOut = Candidates.data() + static_cast<size_t>(nThread) * static_cast<size_t>(nK);
+				const int nFound = TopKIndices(pData + nFirst, nNum, nK, pChunkOut, Comp);
+
+				for (int i = 0; i < nFound; i++)
+					pChunkOut[i] += nFirst;
+
+				CandidateCounts[nThread] = nFound;
+			});
+
+		// Compact the per thread results, then select among them like the single threaded version
+		int nNumCandidates = 0;
+		for (int i = 0; i < nNumThreads; i++)
+		{
+			const int* pChunkOut = Candidates.data() + static_cast<size_t>(i) * static_cast<size_t>(nK);
+			for (int j = 0; j < CandidateCounts[i]; j++)
+				Candidates[nNumCandidates++] = pChunkOut[j];
+		}
+
+		auto IndexComp = [pData, &Comp](const int a, const int b)
+		{
+			return Comp(pData[a], pData[b]) || (!Comp(pData[b], pData[a]) && a < b);
+		};
+
+		FTSelect<int>::PartialSort(Candidates.data(), nNumCandidates, nK, IndexComp);
+
+		for (int i = 0; i < nK; i++)
+			pOut[i] = Candidates[i];
+
+		return nK;
+	}
+
+	template<typename Compare = std::greater<T>>
+	static __forceinline int ParallelTopK(const T* pData, const int nCount, const int nK, T* pOut,
+		const int nNumThreads, Compare Comp = Compare())
+	{
+		if (nNumThreads <= 1 || nCount < FT_PARALLEL_SELECT_THRESHOLD)
+			return TopK(pData, nCount, nK, pOut, Comp);
+
+		std::vector<int> Indices(static_cast<size_t>(nK > 0 ? nK : 0));
+		const int nFound = ParallelTopKIndices(pData, nCount, nK, Indices.data(), nNumThreads, Comp);
+
+		for (int i = 0; i < nFound; i++)
+			pOut[i] = pData[Indices[i]];
+
+		return nFound;
+	}
+
+private:
+	static __forceinline int Log2(int nValue) noexcept
+	{
+		int nLog = 0;
+		while (nValue >>= 1)
+			nLog++;
+
+		return nLog;
+	}
+
+	template<typename Compare>
+	static __forceinline void InsertionSort(T* pData, const int nCount, Compare& Comp)
+	{
+		for (int i = 1; i < nCount; i++)
+		{
+			T Value = std::move(pData[i]);
+
+			int j = i;
+			for (; j > 0 && Comp(Value, pData[j - 1]); j--)
+				pData[j] = std::move(pData[j - 1]);
+
+			pData[j] = std::move(Value);
+		}
+	}
+
+	/*
+	 * Splits [nLow, nHigh) into [nLow, nLess) before the pivot, [nLess, nGreater) equal to it
+	 * and [nGreater, nHigh) after it
+	 */
+	template<typename Compare>
+	static __forceinline void Partition(T* pData, const int nLow, const int nHigh, int& nLess, int& nGreater,
+		Compare& Comp)
+	{
+		const int nMid = nLow + ((nHigh - nLow) >> 1);
+		const int nLast = nHigh - 1;
+
+		// Median of three, afterwards pData[nMid] holds the median
+		if (Comp(pData[nMid], pData[nLow]))
+			std::swap(pData[nMid], pData[nLow]);
+		if (Comp(pData[nLast], pData[nMid]))
+		{
+			std::swap(pData[nLast], pData[nMid]);
+			if (Comp(pData[nMid], pData[nLow]))
+				std::swap(pData[nMid], pData[nLow]);
+		}
+
+		const T Pivot = pData[nMid];
+
+		int i = nLow;
+		nLess = nLow;
+		nGreater = nHigh;
+
+		while (i < nGreater)
+		{
+			if (Comp(pData[i], Pivot))
+				std::swap(pData[nLess++], pData[i++]);
+			else if (Comp(Pivot, pData[i]))
+				std::swap(pData[i], pData[--nGreater]);
+			else
+				i++;
+		}
+	}
+};
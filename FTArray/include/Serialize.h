@@ -0,0 +1,307 @@
+#pragma once
+#include <io.h>
+#include <fcntl.h>
+#include <cstring>
+#include <type_traits>
+
+#include "Globals.h"
+
+/*
+ * File layout, little endian:
+ * FTArrayFileHeader | nCount * nElementSize bytes of raw elements | 8 byte checksum of the elements
+ * The checksum trails the data so a writer can stream chunks without knowing it up front
+ */
+constexpr unsigned int FT_SERIALIZE_MAGIC = 0x52415446; // "FTAR"
+constexpr unsigned short FT_SERIALIZE_VERSION = 1;
+
+// Largest single _read/_write, they take an unsigned int byte count
+constexpr unsigned int FT_SERIALIZE_CHUNK_SIZE = 64u << 20;
+
+struct FTArrayFileHeader
+{
+	unsigned int nMagic;
+	unsigned short nVersion;
+	unsigned short nHeaderSize;
+	unsigned int nElementSize;
+	unsigned int nFlags;
+	unsigned long long nCount;
+};
+
+/*
+ * 64-bit checksum over 32 byte stripes in four independent lanes (the xxHash64 round),
+ * fast enough that it doesn't slow down reads and writes that are already disk bound
+ * Update can be fed any chunking of the data, the result is the same
+ */
+class FTChecksum
+{
+	static constexpr unsigned long long s_nPrime1 = 0x9E3779B185EBCA87ull;
+	static constexpr unsigned long long s_nPrime2 = 0xC2B2AE3D27D4EB4Full;
+	static constexpr unsigned long long s_nPrime3 = 0x165667B19E3779F9ull;
+	static constexpr unsigned long long s_nPrime5 = 0x27D4EB2F165667C5ull;
+
+public:
+	__forceinline void Update(const void* pData, size_t nBytes) noexcept
+	{
+		// pData may be null for an empty array, memcpy must not see it even with a zero size
+		if (!nBytes)
+			return;
+
+		const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+		m_nTotalBytes += nBytes;
+
+		if (m_nBuffered)
+		{
+			const size_t nNum = (sizeof(m_Buffer) - m_nBuffered < nBytes) ? sizeof(m_Buffer) - m_nBuffered : nBytes;
+			memcpy(m_Buffer + m_nBuffered, pBytes, nNum);
+			m_nBuffered += nNum;
+			pBytes += nNum;
+			nBytes -= nNum;
+
+			if (m_nBuffered < sizeof(m_Buffer))
+				return;
+
+			ProcessStripe(m_Buffer);
+			m_nBuffered = 0;
+		}
+
+		for (; nBytes >= sizeof(m_Buffer); nBytes -= sizeof(m_Buffer), pBytes += sizeof(m_Buffer))
+			ProcessStripe(pBytes);
+
+		memcpy(m_Buffer, pBytes, nBytes);
+		m_nBuffered = nBytes;
+	}
+
+	__forceinline unsigned long long Final() const noexcept
+	{
+		unsigned long long nHash = RotateLeft(m_Lanes[0], 1) + RotateLeft(m_Lanes[1], 7)
+			+ RotateLeft(m_Lanes[2], 12) + RotateLeft(m_Lanes[3], 18);
+
+		nHash += m_nTotalBytes;
+
+		for (size_t i = 0; i < m_nBuffered; i++)
+			nHash = RotateLeft(nHash ^ (m_Buffer[i] * s_nPrime5), 11) * s_nPrime1;
+
+		nHash ^= nHash >> 33;
+		nHash *= s_nPrime2;
+		nHash ^= nHash >> 29;
+		nHash *= s_nPrime3;
+		nHash ^= nHash >> 32;
+
+		return nHash;
+	}
+
+private:
+	static __forceinline unsigned long long RotateLeft(const unsigned long long nValue, const int nBits) noexcept
+	{
+		return (nValue << nBits) | (nValue >> (64 - nBits));
+	}
+
+	__forceinline void ProcessStripe(const unsigned char* pStripe) noexcept
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			unsigned long long nWord;
+			memcpy(&nWord, pStripe + i * 8, sizeof(nWord));
+
+			m_Lanes[i] = RotateLeft(m_Lanes[i] + nWord * s_nPrime2, 31) * s_nPrime1;
+		}
+	}
+
+	unsigned long long m_Lanes[4] = { s_nPrime1 + s_nPrime2, s_nPrime2, 0, 0 - s_nPrime1 };
+	unsigned long long m_nTotalBytes = 0;
+	unsigned char m_Buffer[32] = {};
+	size_t m_nBuffered = 0;
+};
+
+// Both loop until everything is transferred, _read/_write may do less than asked for
+__forceinline bool FTWriteAll(const int nFd, const void* pData, size_t nBytes) noexcept
+{
+	const char* pBytes = static_cast<const char*>(pData);
+
+	while (nBytes)
+	{
+		const unsigned int nNum = (nBytes < FT_SERIALIZE_CHUNK_SIZE) ? static_cast<unsigned int>(nBytes) : FT_SERIALIZE_CHUNK_SIZE;
+
+		const int nWritten = _write(nFd, pBytes, nNum);
+		if (nWritten <= 0)
+			return false;
+
+		pBytes += nWritten;
+		nBytes -= static_cast<size_t>(nWritten);
+	}
+
+	return true;
+}
+
+__forceinline bool FTReadAll(const int nFd, void* pData, size_t nBytes) noexcept
+{
+	char* pBytes = static_cast<char*>(pData);
+
+	while (nBytes)
+	{
+		const unsigned int nNum = (nBytes < FT_SERIALIZE_CHUNK_SIZE) ? static_cast<unsigned int>(nBytes) : FT_SERIALIZE_CHUNK_SIZE;
+
+		const int nRead = _read(nFd, pBytes, nNum);
+		if (nRead <= 0)
+			return false;
+
+		pBytes += nRead;
+		nBytes -= static_cast<size_t>(nRead);
+	}
+
+	return true;
+}
+
+/*
+ * Writes a header for nCount elements, then takes the elements in as many Write calls as
+ * the caller likes so arrays larger than any in-memory buffer can be streamed out
+ * Finish writes the checksum and fails if the element count doesn't match the header
+ * The fd is switched to binary mode, a text mode fd would turn every 0x0A byte into CRLF
+ */
+template<typename T>
+class FTArrayStreamWriter
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be serialized");
+
+public:
+	__forceinline FTArrayStreamWriter(const int nFd, const unsigned long long nCount) noexcept
+		: m_nFd(nFd), m_nCount(nCount)
+	{
+		if (_setmode(m_nFd, _O_BINARY) == -1)
+			return;
+
+		FTArrayFileHeader Header = {};
+		Header.nMagic = FT_SERIALIZE_MAGIC;
+		Header.nVersion = FT_SERIALIZE_VERSION;
+		Header.nHeaderSize = sizeof(FTArrayFileHeader);
+		Header.nElementSize = sizeof(T);
+		Header.nCount = nCount;
+
+		m_bValid = FTWriteAll(m_nFd, &Header, sizeof(Header));
+	}
+
+	__forceinline bool IsValid() const noexcept
+	{
+		return m_bValid;
+	}
+
+	__forceinline bool Write(const T* pElements, const int nNum) noexcept
+	{
+		FT_ASSERT(nNum >= 0);
+
+		if (!m_bValid || m_nWritten + static_cast<unsigned long long>(nNum) > m_nCount)
+		{
+			m_bValid = false;
+			return false;
+		}
+
+		const size_t nBytes = static_cast<size_t>(nNum) * sizeof(T);
+		m_Checksum.Update(pElements, nBytes);
+
+		m_bValid = FTWriteAll(m_nFd, pElements, nBytes);
+		m_nWritten += static_cast<unsigned long long>(nNum);
+		return m_bValid;
+	}
+
+	__forceinline bool Finish() noexcept
+	{
+		if (!m_bValid || m_nWritten != m_nCount)
+			return false;
+
+		const unsigned long long nChecksum = m_Checksum.Final();
+		return FTWriteAll(m_nFd, &nChecksum, sizeof(nChecksum));
+	}
+
+private:
+	int m_nFd;
+	bool m_bValid = false;
+	unsigned long long m_nCount;
+	unsigned long long m_nWritten = 0;
+	FTChecksum m_Checksum;
+};
+
+/*
+ * Validates the header on construction, Read then copies elements straight into the caller's
+ * memory chunk by chunk and Finish checks the trailing checksum against what was read
+ * The fd is switched to binary mode, in text mode reads would stop at the first 0x1A byte
+ */
+template<typename T>
+class FTArrayStreamReader
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be serialized");
+
+public:
+	__forceinline explicit FTArrayStreamReader(const int nFd) noexcept : m_nFd(nFd)
+	{
+		if (_setmode(m_nFd, _O_BINARY) == -1)
+			return;
+
+		FTArrayFileHeader Header;
+		if (!FTReadAll(m_nFd, &Header, sizeof(Header)))
+			return;
+
+		if (Header.nMagic != FT_SERIALIZE_MAGIC || Header.nVersion != FT_SERIALIZE_VERSION
+			|| Header.nHeaderSize != sizeof(FTArrayFileHeader) || Header.nElementSize != sizeof(T))
+			return;
+
+		m_nCount = Header.nCount;
+		m_bValid = true;
+	}
+
+	__forceinline bool IsValid() const noexcept
+	{
+		return m_bValid;
+	}
+
+	__forceinline unsigned long long GetCount() const noexcept
+	{
+		return m_nCount;
+	}
+
+	__forceinline unsigned long long GetRemaining() const noexcept
+	{
+		return m_nCount - m_nRead;
+	}
+
+	// Reads up to nMaxNum elements, returns how many were read or FT_INVALID_INDEX on failure
+	__forceinline int Read(T* pElements, const int nMaxNum) noexcept
+	{
+		FT_ASSERT(nMaxNum >= 0);
+
+		if (!m_bValid)
+			return FT_INVALID_INDEX;
+
+		const int nNum = (GetRemaining() < static_cast<unsigned long long>(nMaxNum))
+			? static_cast<int>(GetRemaining()) : nMaxNum;
+
+		const size_t nBytes = static_cast<size_t>(nNum) * sizeof(T);
+		if (!FTReadAll(m_nFd, pElements, nBytes))
+		{
+			m_bValid = false;
+			return FT_INVALID_INDEX;
+		}
+
+		m_Checksum.Update(pElements, nBytes);
+		m_nRead += static_cast<unsigned long long>(nNum);
+		return nNum;
+	}
+
+	__forceinline bool Finish() noexcept
+	{
+		if (!m_bValid || m_nRead != m_nCount)
+			return false;
+
+		unsigned long long nChecksum;
+		if (!FTReadAll(m_nFd, &nChecksum, sizeof(nChecksum)))
+			return false;
+
+		return nChecksum == m_Checksum.Final();
+	}
+
+private:
+	int m_nFd;
+	bool m_bValid = false;
+	unsigned long long m_nCount = 0;
+	unsigned long long m_nRead = 0;
+	FTChecksum m_Checksum;
+};